@@ -7,57 +7,99 @@
 /****************************************************/
 
 #include "globals.h"
+#include "util.h"
 #include "symtab.h"
 #include "analyze.h"
 
 /* counter for variable memory locations */
 static int location = 0;
 
-/* Procedure traverse is a generic recursive 
+/* counter for frame offsets in the current
+ * function, or -1 outside functions
+ */
+static int frameOffset = -1;
+
+/* the procedures applied by traverse */
+static void (* travPre) (TreeNode *);
+static void (* travPost) (TreeNode *);
+
+static void travVisit( TreeNode * t, int phase)
+{ if (phase == 0) travPre(t);
+  if (phase < MAXCHILDREN) walkList(t->child[phase]);
+  else travPost(t);
+}
+
+/* Procedure traverse is a generic
  * syntax tree traversal routine:
  * it applies preProc in preorder and postProc 
  * in postorder to tree pointed to by t
+ * (by walkTree, so deep trees are fine)
  */
 static void traverse( TreeNode * t,
                void (* preProc) (TreeNode *),
                void (* postProc) (TreeNode *) )
-{ if (t != NULL)
-  { preProc(t);
-    { int i;
-      for (i=0; i < MAXCHILDREN; i++)
-        traverse(t->child[i],preProc,postProc);
-    }
-    postProc(t);
-    traverse(t->sibling,preProc,postProc);
-  }
+{ travPre = preProc;
+  travPost = postProc;
+  walkTree(t,travVisit);
 }
 
-/* nullProc is a do-nothing procedure to 
- * generate preorder-only or postorder-only
- * traversals from traverse
+/* the function whose body is being analyzed */
+static TreeNode * curFunc = NULL;
+
+static void declError(TreeNode * t, char * message)
+{ fprintf(listing,"Declaration error at line %d: %s %s\n",
+          t->lineno,message,t->attr.name);
+  Error = TRUE;
+}
+
+/* Procedure declare binds the name of t in the
+ * current scope: globals take memory locations,
+ * parameters and locals take frame offsets
  */
-static void nullProc(TreeNode * t)
-{ if (t==NULL) return;
-  else return;
+static void declare( TreeNode * t, SymKind kind, ExpType type, int size )
+{ int * counter = (frameOffset < 0) ? &location : &frameOffset;
+  if (type == Void)
+    declError(t,"void variable");
+  t->sym = st_declare(t->attr.atom,kind,type,*counter,size);
+  if (t->sym != NULL)
+    *counter += size;
+  else
+    declError(t,"redeclaration of");
 }
 
 /* Procedure insertNode inserts 
  * identifiers stored in t into 
- * the symbol table 
+ * the symbol table, and gives each node
+ * that names a symbol a pointer to it
  */
 static void insertNode( TreeNode * t)
 { switch (t->nodekind)
   { case StmtK:
       switch (t->kind.stmt)
-      { case AssignK:
+      { case FuncK:
+        { /* the function is global; its parameters
+             and body get a scope of their own */
+          Symbol * s = st_declare(t->attr.atom,FuncSym,t->type,0,0);
+          if (s != NULL) s->decl = t;
+          else declError(t,"redeclaration of");
+          t->sym = st_insert(t->attr.atom,t->lineno,&location);
+          st_enterScope(t->attr.atom);
+          frameOffset = FRAMEHDR;
+          curFunc = t;
+          break;
+        }
+        case DeclareK:
+        { TreeNode * p;
+          for (p = t->child[0]; p != NULL; p = p->sibling)
+            if (p->attr.val > 0) declare(p,ArraySym,t->type,p->attr.val);
+            else declare(p,VarSym,t->type,1);
+          break;
+        }
+        case AssignK:
         case ReadK:
-          if (st_lookup(t->attr.name) == -1)
-          /* not yet in table, so treat as new definition */
-            st_insert(t->attr.name,t->lineno,location++);
-          else
-          /* already in table, so ignore location, 
-             add line number of use only */ 
-            st_insert(t->attr.name,t->lineno,0);
+          /* a new variable takes the next location;
+             otherwise only the line number of use is added */
+          t->sym = st_insert(t->attr.atom,t->lineno,&location);
           break;
         default:
           break;
@@ -65,14 +107,16 @@ static void insertNode( TreeNode * t)
       break;
     case ExpK:
       switch (t->kind.exp)
-      { case IdK:
-          if (st_lookup(t->attr.name) == -1)
-          /* not yet in table, so treat as new definition */
-            st_insert(t->attr.name,t->lineno,location++);
-          else
-          /* already in table, so ignore location, 
-             add line number of use only */ 
-            st_insert(t->attr.name,t->lineno,0);
+      { case ParamK:
+          declare(t,ParamSym,t->type,1);
+          t->sym = st_insert(t->attr.atom,t->lineno,&location);
+          break;
+        case IdK:
+        case ArrayK:
+        case CallK:
+          /* a new variable takes the next location;
+             otherwise only the line number of use is added */
+          t->sym = st_insert(t->attr.atom,t->lineno,&location);
           break;
         default:
           break;
@@ -83,11 +127,25 @@ static void insertNode( TreeNode * t)
   }
 }
 
+/* Procedure exitNode closes the scope of a
+ * function after its body; the size of the
+ * function's symbol is the words of its frame
+ */
+static void exitNode( TreeNode * t)
+{ if (t->nodekind == StmtK && t->kind.stmt == FuncK)
+  { if (t->sym != NULL && t->sym->kind == FuncSym)
+      t->sym->size = frameOffset;
+    st_exitScope();
+    frameOffset = -1;
+  }
+}
+
 /* Function buildSymtab constructs the symbol 
- * table by preorder traversal of the syntax tree
+ * table by preorder traversal of the syntax tree,
+ * with a scope for each function
  */
 void buildSymtab(TreeNode * syntaxTree)
-{ traverse(syntaxTree,insertNode,nullProc);
+{ traverse(syntaxTree,insertNode,exitNode);
   if (TraceAnalyze)
   { fprintf(listing,"\nSymbol table:\n\n");
     printSymTab(listing);
@@ -99,25 +157,121 @@ static void typeError(TreeNode * t, char * message)
   Error = TRUE;
 }
 
+/* isNumeric is TRUE for the types of arithmetic */
+#define isNumeric(type) ((type) == Integer || (type) == Float)
+
+/* Function convert returns expression e converted
+ * to numeric type: e itself if it has that type
+ * already, else a new ConvK node that takes the
+ * place of e in its sibling list
+ */
+static TreeNode * convert( TreeNode * e, ExpType type)
+{ TreeNode * c;
+  if (e->type == type) return e;
+  c = newExpNode(ConvK);
+  if (c == NULL) return e;
+  c->child[0] = e;
+  c->sibling = e->sibling;
+  e->sibling = NULL;
+  c->lineno = e->lineno;
+  c->type = type;
+  return c;
+}
+
+/* Function coerce returns expression e as a value
+ * of type: converted if both types are numeric,
+ * unchanged (after reporting message) if the
+ * types do not match
+ */
+static TreeNode * coerce( TreeNode * e, ExpType type, char * message)
+{ if (e->type == type || e->type == Unknown || type == Unknown)
+    return e;
+  if (isNumeric(e->type) && isNumeric(type))
+    return convert(e,type);
+  typeError(e,message);
+  return e;
+}
+
+/* Procedure checkCall checks the arguments of
+ * call t against the parameters of the function,
+ * converting numeric arguments as needed
+ */
+static void checkCall( TreeNode * t)
+{ TreeNode ** arg = &t->child[0];
+  TreeNode * param = t->sym->decl->child[0];
+  while (*arg != NULL && param != NULL)
+  { *arg = coerce(*arg,param->type,"argument of wrong type");
+    arg = &(*arg)->sibling;
+    param = param->sibling;
+  }
+  if (*arg != NULL || param != NULL)
+    typeError(t,"wrong number of arguments");
+}
+
 /* Procedure checkNode performs
- * type checking at a single tree node
+ * type checking at a single tree node,
+ * storing the type of each expression in it
  */
 static void checkNode(TreeNode * t)
-{ switch (t->nodekind)
+{ Symbol * s = t->sym;
+  switch (t->nodekind)
   { case ExpK:
       switch (t->kind.exp)
       { case OpK:
-          if ((t->child[0]->type != Integer) ||
-              (t->child[1]->type != Integer))
-            typeError(t,"Op applied to non-integer");
+        { ExpType l = t->child[0]->type, r = t->child[1]->type;
+          ExpType operand = Integer;
+          if (l == Unknown || r == Unknown)
+            operand = Unknown;
+          else if (!isNumeric(l) || !isNumeric(r))
+          { typeError(t,"Op applied to non-numeric value");
+            operand = Unknown;
+          }
+          else if (l == Float || r == Float)
+          { /* integer operands are promoted at compile time */
+            operand = Float;
+            t->child[0] = convert(t->child[0],Float);
+            t->child[1] = convert(t->child[1],Float);
+          }
           if ((t->attr.op == EQ) || (t->attr.op == LT))
             t->type = Boolean;
           else
-            t->type = Integer;
+            t->type = operand;
           break;
+        }
         case ConstK:
+          if (t->type != Float) t->type = Integer;
+          break;
         case IdK:
-          t->type = Integer;
+          if (s->kind == FuncSym)
+          { typeError(t,"function used as a variable");
+            t->type = Unknown;
+          }
+          else if (s->kind == ArraySym && t->attr.val == 0)
+          { typeError(t,"array used without an index");
+            t->type = Unknown;
+          }
+          else t->type = s->type;
+          break;
+        case ArrayK:
+          if (s->kind != ArraySym)
+          { typeError(t,"index applied to a non-array");
+            t->type = Unknown;
+          }
+          else
+          { if (t->child[0]->type != Integer && t->child[0]->type != Unknown)
+              typeError(t->child[0],"array index is not integer");
+            t->type = s->type;
+          }
+          break;
+        case CallK:
+          if (s->kind != FuncSym)
+          { typeError(t,"call of a non-function");
+            t->type = Unknown;
+          }
+          else
+          { if (s->decl != NULL) checkCall(t);
+            t->type = s->type;
+          }
           break;
         default:
           break;
@@ -126,20 +280,41 @@ static void checkNode(TreeNode * t)
     case StmtK:
       switch (t->kind.stmt)
       { case IfK:
-          if (t->child[0]->type == Integer)
+          if (t->child[0]->type != Boolean && t->child[0]->type != Unknown)
             typeError(t->child[0],"if test is not Boolean");
           break;
+        case WhileK:
+          if (t->child[0]->type != Boolean && t->child[0]->type != Unknown)
+            typeError(t->child[0],"while test is not Boolean");
+          break;
+        case RepeatK:
+          if (t->child[1]->type != Boolean && t->child[1]->type != Unknown)
+            typeError(t->child[1],"repeat test is not Boolean");
+          break;
         case AssignK:
-          if (t->child[0]->type != Integer)
-            typeError(t->child[0],"assignment of non-integer value");
+          if (s->kind == VarSym || s->kind == ParamSym)
+            t->child[0] = coerce(t->child[0],s->type,"assignment of wrong type");
+          else
+            typeError(t,"assignment to a non-variable");
+          break;
+        case ReadK:
+          if ((s->kind != VarSym && s->kind != ParamSym) || !isNumeric(s->type))
+            typeError(t,"read of a non-numeric variable");
           break;
         case WriteK:
-          if (t->child[0]->type != Integer)
-            typeError(t->child[0],"write of non-integer value");
+          if (!isNumeric(t->child[0]->type) && t->child[0]->type != Unknown)
+            typeError(t->child[0],"write of non-numeric value");
           break;
-        case RepeatK:
-          if (t->child[1]->type == Integer)
-            typeError(t->child[1],"repeat test is not Boolean");
+        case ReturnK:
+          if (curFunc == NULL)
+            typeError(t,"return outside a function");
+          else if (curFunc->type == Void)
+            typeError(t,"return of a value from a void function");
+          else
+            t->child[0] = coerce(t->child[0],curFunc->type,"return of wrong type");
+          break;
+        case FuncK:
+          curFunc = NULL;
           break;
         default:
           break;
@@ -151,9 +326,66 @@ static void checkNode(TreeNode * t)
   }
 }
 
+/* enterFunc notes the function whose body
+ * typeCheck is entering
+ */
+static void enterFunc(TreeNode * t)
+{ if (t->nodekind == StmtK && t->kind.stmt == FuncK)
+    curFunc = t;
+}
+
 /* Procedure typeCheck performs type checking 
  * by a postorder syntax tree traversal
  */
 void typeCheck(TreeNode * syntaxTree)
-{ traverse(syntaxTree,nullProc,checkNode);
+{ traverse(syntaxTree,enterFunc,checkNode);
+}
+
+/* Procedure analyzeVisit builds the symbol table
+ * and checks types in one walk: identifiers are
+ * inserted in preorder, types checked in postorder
+ * while the scope of the node is still open
+ */
+static void analyzeVisit( TreeNode * t, int phase)
+{ if (phase == 0) insertNode(t);
+  if (phase < MAXCHILDREN) walkList(t->child[phase]);
+  else
+  { checkNode(t);
+    exitNode(t);
+  }
+}
+
+/* TRUE once functions are analyzed as they are
+ * parsed, so analyze skips them
+ */
+static int functionsDone = FALSE;
+
+/* Procedure analyzeFunction builds the symbol
+ * table and checks types of one function; it is
+ * the parser's functionHook when analyzing
+ * function by function
+ */
+void analyzeFunction(TreeNode * func)
+{ TreeNode * sibling = func->sibling;
+  func->sibling = NULL;
+  walkTree(func,analyzeVisit);
+  func->sibling = sibling;
+  functionsDone = TRUE;
+}
+
+/* Procedure analyze builds the symbol table and
+ * checks types in a single traversal of the
+ * syntax tree, skipping functions already
+ * analyzed by analyzeFunction
+ */
+void analyze(TreeNode * syntaxTree)
+{ TreeNode * t = syntaxTree;
+  if (functionsDone)
+    while (t != NULL && t->nodekind == StmtK && t->kind.stmt == FuncK)
+      t = t->sibling;
+  walkTree(t,analyzeVisit);
+  if (TraceAnalyze)
+  { fprintf(listing,"\nSymbol table:\n\n");
+    printSymTab(listing);
+  }
 }
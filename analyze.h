@@ -9,7 +9,8 @@
 #define _ANALYZE_H_
 
 /* Function buildSymtab constructs the symbol 
- * table by preorder traversal of the syntax tree
+ * table by preorder traversal of the syntax tree,
+ * with a scope for each function
  */
 void buildSymtab(TreeNode *);
 
@@ -18,4 +19,18 @@ void buildSymtab(TreeNode *);
  */
 void typeCheck(TreeNode *);
 
+/* Procedure analyze builds the symbol table and
+ * checks types in a single traversal of the
+ * syntax tree, skipping functions already
+ * analyzed by analyzeFunction
+ */
+void analyze(TreeNode *);
+
+/* Procedure analyzeFunction builds the symbol
+ * table and checks types of one function; it is
+ * the parser's functionHook when analyzing
+ * function by function
+ */
+void analyzeFunction(TreeNode *);
+
 #endif
@@ -0,0 +1,132 @@
+/****************************************************/
+/* File: arena.c                                    */
+/* Arena (bump) allocator for the TINY compiler     */
+/* Memory is taken from a list of large blocks by   */
+/* bumping a pointer; nothing is freed on its own   */
+/****************************************************/
+
+#include "globals.h"
+#include "arena.h"
+
+/* BLOCKSIZE is the usual size of an arena block;
+ * larger requests get a block of their own
+ */
+#define BLOCKSIZE (256 * 1024)
+
+/* ALIGN is the alignment of every allocation */
+#define ALIGN 8
+
+typedef struct BlockRec
+{
+    struct BlockRec* next;
+    size_t size; /* usable bytes after the header */
+} Block;
+
+#define HEADERSIZE ((sizeof(Block) + ALIGN - 1) & ~(size_t)(ALIGN - 1))
+#define BLOCKDATA(b) ((char*)(b) + HEADERSIZE)
+
+/* the chain of blocks, the block in use and the
+ * first free byte inside it
+ */
+static Block* firstBlock = NULL;
+static Block* curBlock = NULL;
+static size_t curPos = 0;
+
+/* statistics since the arena was created */
+static long allocCount = 0;   /* calls of arenaAlloc */
+static long blockCount = 0;   /* blocks taken from malloc */
+static size_t blockBytes = 0; /* bytes held in blocks */
+static size_t usedBytes = 0;  /* bytes in use since the last reset */
+static size_t peakBytes = 0;  /* largest usedBytes seen */
+
+/* newBlock returns the block that follows curBlock,
+ * reusing the next block of the chain if it is big
+ * enough and inserting a new one otherwise
+ */
+static Block* newBlock(size_t size)
+{
+    Block* b;
+    if (curBlock != NULL && curBlock->next != NULL && curBlock->next->size >= size)
+        return curBlock->next;
+    if (size < BLOCKSIZE) size = BLOCKSIZE;
+    b = (Block*)malloc(HEADERSIZE + size);
+    if (b == NULL) return NULL;
+    b->size = size;
+    if (curBlock == NULL)
+    {
+        b->next = NULL;
+        firstBlock = b;
+    }
+    else
+    {
+        b->next = curBlock->next;
+        curBlock->next = b;
+    }
+    blockCount++;
+    blockBytes += size;
+    return b;
+}
+
+/* Function arenaAlloc returns size bytes of zeroed
+ * memory from the arena, or NULL if out of memory;
+ * the memory lives until the next arenaReset
+ */
+void* arenaAlloc(size_t size)
+{
+    char* p;
+    size = (size + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+    if (curBlock == NULL || curPos + size > curBlock->size)
+    {
+        Block* b = newBlock(size);
+        if (b == NULL) return NULL;
+        curBlock = b;
+        curPos = 0;
+    }
+    p = BLOCKDATA(curBlock) + curPos;
+    curPos += size;
+    allocCount++;
+    usedBytes += size;
+    if (usedBytes > peakBytes) peakBytes = usedBytes;
+    memset(p, 0, size);
+    return p;
+}
+
+/* Procedure arenaReset releases everything allocated
+ * from the arena in O(1); its blocks are kept and
+ * reused by the next compilation unit
+ */
+void arenaReset(void)
+{
+    curBlock = firstBlock;
+    curPos = 0;
+    usedBytes = 0;
+}
+
+/* Procedure arenaFree returns all blocks of the
+ * arena to the C library
+ */
+void arenaFree(void)
+{
+    while (firstBlock != NULL)
+    {
+        Block* b = firstBlock;
+        firstBlock = b->next;
+        free(b);
+    }
+    curBlock = NULL;
+    curPos = 0;
+    usedBytes = 0;
+    blockBytes = 0;
+}
+
+/* Procedure printArenaStats prints allocation
+ * counts and peak memory use of the arena to
+ * the listing file
+ */
+void printArenaStats(FILE* listing)
+{
+    fprintf(listing, "\nArena: %ld allocations in %ld blocks from malloc\n",
+        allocCount, blockCount);
+    fprintf(listing, "Arena: peak %lu bytes used, %lu bytes reserved\n",
+        (unsigned long)peakBytes, (unsigned long)blockBytes);
+}
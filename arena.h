@@ -0,0 +1,34 @@
+/****************************************************/
+/* File: arena.h                                    */
+/* Arena (bump) allocator for the TINY compiler:    */
+/* owns the syntax tree nodes and strings of one    */
+/* compilation unit                                 */
+/****************************************************/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+/* Function arenaAlloc returns size bytes of zeroed
+ * memory from the arena, or NULL if out of memory;
+ * the memory lives until the next arenaReset
+ */
+void* arenaAlloc(size_t size);
+
+/* Procedure arenaReset releases everything allocated
+ * from the arena in O(1); its blocks are kept and
+ * reused by the next compilation unit
+ */
+void arenaReset(void);
+
+/* Procedure arenaFree returns all blocks of the
+ * arena to the C library
+ */
+void arenaFree(void);
+
+/* Procedure printArenaStats prints allocation
+ * counts and peak memory use of the arena to
+ * the listing file
+ */
+void printArenaStats(FILE* listing);
+
+#endif
@@ -8,180 +8,658 @@
 /****************************************************/
 
 #include "globals.h"
+#include "util.h"
+#include "intern.h"
 #include "symtab.h"
 #include "code.h"
+#include "peep.h"
+#include "ir.h"
+#include "ssa.h"
+#include "opt.h"
+#include "irgen.h"
 #include "cgen.h"
 
 /* tmpOffset is the memory offset for temps
    It is decremented each time a temp is
-   stored, and incremeted when loaded again
+   stored, and incremeted when loaded again.
+   A function frame (symtab.h) lies below the
+   temps of its caller and is addressed from mp;
+   the function's temps lie below its frame
 */
 static int tmpOffset = 0;
 
-/* prototype for internal recursive code generator */
-static void cGen (TreeNode * tree);
+/* Registers FIRSTTMP.. hold the left operands
+ * of binary operations while the right ones are
+ * evaluated; deeper operands spill to the temps
+ * at mp. tmpRegs counts the operands held, so
+ * operand tmpRegs is in register FIRSTTMP+tmpRegs-1
+ * if tmpRegs <= NTMPREGS, else in memory
+ */
+#define FIRSTTMP 2
+#define NTMPREGS 3
+static int tmpRegs = 0;
+
+/* The code locations still to be backpatched
+ * by the statement being generated; they are
+ * saved in one phase of its visit and used in
+ * a later one, so they form a stack
+ */
+static int * savedLocs = NULL;
+static int nsaved = 0, maxsaved = 0;
+
+static void pushLoc( int loc )
+{ if (nsaved == maxsaved)
+  { maxsaved = maxsaved ? 2*maxsaved : 64;
+    savedLocs = (int *) realloc(savedLocs, maxsaved*sizeof(int));
+    if (savedLocs == NULL)
+    { fprintf(listing,"Out of memory error generating code\n");
+      exit(1);
+    }
+  }
+  savedLocs[nsaved++] = loc;
+}
+
+static int popLoc( void )
+{ return savedLocs[--nsaved];
+}
+
+/* mainJump is the location of the jump over the
+ * functions to the program, -1 if there is none
+ */
+static int mainJump = -1;
+
+/* The calls of functions whose code comes later:
+ * fixLocs holds the location of each jump to be
+ * patched, fixSyms the function it calls
+ */
+static int * fixLocs = NULL;
+static Symbol ** fixSyms = NULL;
+static int nfix = 0, maxfix = 0;
+
+static void addFixup( int loc, Symbol * s )
+{ if (nfix == maxfix)
+  { maxfix = maxfix ? 2*maxfix : 16;
+    fixLocs = (int *) realloc(fixLocs, maxfix*sizeof(int));
+    fixSyms = (Symbol **) realloc(fixSyms, maxfix*sizeof(Symbol *));
+    if (fixLocs == NULL || fixSyms == NULL)
+    { fprintf(listing,"Out of memory error generating code\n");
+      exit(1);
+    }
+  }
+  fixLocs[nfix] = loc;
+  fixSyms[nfix++] = s;
+}
+
+/* Function base returns the register variable s
+ * is addressed from: gp for globals, mp for the
+ * parameters and locals in the frame
+ */
+static int base( Symbol * s )
+{ return s->scope == 0 ? gp : mp;
+}
+
+/* Procedure clearLocals emits the code clearing
+ * the n words of the frame from offset loc, as
+ * locals start out zero like globals
+ */
+static void clearLocals( int loc, int n )
+{ if (n > 0) emitRM("LDC",ac,0,0,"function: zero");
+  if (n > 0 && n <= 4)
+    while (n-- > 0)
+      emitRM("ST",ac,loc++,mp,"function: clear local");
+  else if (n > 0)
+  { emitRM("LDA",ac1,loc,mp,"function: address of locals");
+    emitRM("LDC",FIRSTTMP,n,0,"function: words of locals");
+    emitRM("ST",ac,0,ac1,"function: clear local");
+    emitRM("LDA",ac1,1,ac1,"function: next local");
+    emitRM("LDA",FIRSTTMP,-1,FIRSTTMP,"function: count down");
+    emitRM("JNE",FIRSTTMP,-4,pc,"function: clear the next");
+  }
+}
+
+/* Procedure genReturn emits the return from a
+ * function, with its value in ac: the return
+ * address and the caller's mp are in the frame
+ */
+static void genReturn( void )
+{ emitRM("LD",ac1,0,mp,"return: load return address");
+  emitRM("LD",mp,1,mp,"return: restore caller's mp");
+  emitRM("LDA",pc,0,ac1,"return");
+}
 
-/* Procedure genStmt generates code at a statement node */
-static void genStmt( TreeNode * tree)
-{ TreeNode * p1, * p2, * p3;
-  int savedLoc1,savedLoc2,currentLoc;
+/* Procedure genStmt generates code at a statement
+ * node; phase counts the visits of walkTree, and
+ * walkList generates the code of a child
+ */
+static void genStmt( TreeNode * tree, int phase)
+{ int savedLoc1,savedLoc2,currentLoc;
   int loc;
+  TreeNode * p;
   switch (tree->kind.stmt) {
 
       case IfK :
-         if (TraceCode) emitComment("-> if") ;
-         p1 = tree->child[0] ;
-         p2 = tree->child[1] ;
-         p3 = tree->child[2] ;
-         /* generate code for test expression */
-         cGen(p1);
-         savedLoc1 = emitSkip(1) ;
-         emitComment("if: jump to else belongs here");
-         /* recurse on then part */
-         cGen(p2);
-         savedLoc2 = emitSkip(1) ;
-         emitComment("if: jump to end belongs here");
-         currentLoc = emitSkip(0) ;
-         emitBackup(savedLoc1) ;
-         emitRM_Abs("JEQ",ac,currentLoc,"if: jmp to else");
-         emitRestore() ;
-         /* recurse on else part */
-         cGen(p3);
-         currentLoc = emitSkip(0) ;
-         emitBackup(savedLoc2) ;
-         emitRM_Abs("LDA",pc,currentLoc,"jmp to end") ;
-         emitRestore() ;
-         if (TraceCode)  emitComment("<- if") ;
+         switch (phase) {
+            case 0:
+               if (TraceCode) emitComment("-> if") ;
+               /* generate code for test expression */
+               walkList(tree->child[0]);
+               break;
+            case 1:
+               savedLoc1 = emitSkip(1) ;
+               emitComment("if: jump to else belongs here");
+               pushLoc(savedLoc1);
+               /* recurse on then part */
+               walkList(tree->child[1]);
+               break;
+            case 2:
+               savedLoc1 = popLoc();
+               savedLoc2 = emitSkip(1) ;
+               emitComment("if: jump to end belongs here");
+               currentLoc = emitSkip(0) ;
+               emitBackup(savedLoc1) ;
+               emitRM_Abs("JEQ",ac,currentLoc,"if: jmp to else");
+               emitRestore() ;
+               pushLoc(savedLoc2);
+               /* recurse on else part */
+               walkList(tree->child[2]);
+               break;
+            default:
+               savedLoc2 = popLoc();
+               currentLoc = emitSkip(0) ;
+               emitBackup(savedLoc2) ;
+               emitRM_Abs("LDA",pc,currentLoc,"jmp to end") ;
+               emitRestore() ;
+               if (TraceCode)  emitComment("<- if") ;
+               break;
+         }
          break; /* if_k */
 
       case RepeatK:
-         if (TraceCode) emitComment("-> repeat") ;
-         p1 = tree->child[0] ;
-         p2 = tree->child[1] ;
-         savedLoc1 = emitSkip(0);
-         emitComment("repeat: jump after body comes back here");
-         /* generate code for body */
-         cGen(p1);
-         /* generate code for test */
-         cGen(p2);
-         emitRM_Abs("JEQ",ac,savedLoc1,"repeat: jmp back to body");
-         if (TraceCode)  emitComment("<- repeat") ;
+         switch (phase) {
+            case 0:
+               if (TraceCode) emitComment("-> repeat") ;
+               savedLoc1 = emitSkip(0);
+               emitComment("repeat: jump after body comes back here");
+               pushLoc(savedLoc1);
+               /* generate code for body */
+               walkList(tree->child[0]);
+               break;
+            case 1:
+               /* generate code for test */
+               walkList(tree->child[1]);
+               break;
+            default:
+               savedLoc1 = popLoc();
+               emitRM_Abs("JEQ",ac,savedLoc1,"repeat: jmp back to body");
+               if (TraceCode)  emitComment("<- repeat") ;
+               break;
+         }
          break; /* repeat */
 
       case AssignK:
-         if (TraceCode) emitComment("-> assign") ;
-         /* generate code for rhs */
-         cGen(tree->child[0]);
-         /* now store value */
-         loc = st_lookup(tree->attr.name);
-         emitRM("ST",ac,loc,gp,"assign: store value");
-         if (TraceCode)  emitComment("<- assign") ;
+         if (phase == 0)
+         { if (TraceCode) emitComment("-> assign") ;
+           /* generate code for rhs */
+           walkList(tree->child[0]);
+         }
+         else
+         { /* now store value */
+           loc = tree->sym->memloc;
+           emitRM("ST",ac,loc,base(tree->sym),"assign: store value");
+           if (TraceCode)  emitComment("<- assign") ;
+         }
          break; /* assign_k */
 
       case ReadK:
-         emitRO("IN",ac,0,0,"read integer value");
-         loc = st_lookup(tree->attr.name);
-         emitRM("ST",ac,loc,gp,"read: store value");
+         if (tree->sym->type == Float)
+           emitRO("INF",ac,0,0,"read float value");
+         else
+           emitRO("IN",ac,0,0,"read integer value");
+         loc = tree->sym->memloc;
+         emitRM("ST",ac,loc,base(tree->sym),"read: store value");
          break;
       case WriteK:
-         /* generate code for expression to write */
-         cGen(tree->child[0]);
-         /* now output it */
-         emitRO("OUT",ac,0,0,"write ac");
+         if (phase == 0)
+           /* generate code for expression to write */
+           walkList(tree->child[0]);
+         else
+           /* now output it */
+           emitRO(tree->child[0]->type == Float ? "OUTF" : "OUT",
+                  ac,0,0,"write ac");
+         break;
+
+      case WhileK:
+         /* the test is at the bottom, entered first
+            by a jump over the body */
+         switch (phase) {
+            case 0:
+               if (TraceCode) emitComment("-> while") ;
+               savedLoc1 = emitSkip(1) ;
+               emitComment("while: jump to test belongs here");
+               pushLoc(savedLoc1);
+               pushLoc(emitSkip(0));
+               /* generate code for body */
+               walkList(tree->child[1]);
+               break;
+            case 1:
+               savedLoc2 = popLoc();
+               savedLoc1 = popLoc();
+               currentLoc = emitSkip(0) ;
+               emitBackup(savedLoc1) ;
+               emitRM_Abs("LDA",pc,currentLoc,"while: jmp to test");
+               emitRestore() ;
+               pushLoc(savedLoc2);
+               /* generate code for test */
+               walkList(tree->child[0]);
+               break;
+            default:
+               savedLoc2 = popLoc();
+               emitRM_Abs("JNE",ac,savedLoc2,"while: jmp back to body");
+               if (TraceCode)  emitComment("<- while") ;
+               break;
+         }
+         break; /* while */
+
+      case FuncK:
+         if (phase == 0)
+         { if (TraceCode) emitComment("-> function") ;
+           tree->sym->memloc = emitSkip(0);
+           /* the frame holds the return address and
+              the caller's mp, then the parameters,
+              then the locals */
+           loc = FRAMEHDR;
+           for (p = tree->child[0]; p != NULL; p = p->sibling) loc++;
+           clearLocals(loc,tree->sym->size - loc);
+           tmpOffset = -1;
+           walkList(tree->child[1]);
+         }
+         else
+         { /* falling off the end returns 0 */
+           emitRM("LDC",ac,0,0,"function: no return value");
+           genReturn();
+           tmpOffset = 0;
+           if (tree->sibling == NULL || tree->sibling->nodekind != StmtK
+               || tree->sibling->kind.stmt != FuncK)
+           { /* the program follows the last function */
+             currentLoc = emitSkip(0) ;
+             emitBackup(mainJump) ;
+             emitRM_Abs("LDA",pc,currentLoc,"jmp to program");
+             emitRestore() ;
+           }
+           if (TraceCode)  emitComment("<- function") ;
+         }
+         break; /* func_k */
+
+      case ReturnK:
+         if (phase == 0)
+           walkList(tree->child[0]);
+         else
+           genReturn();
          break;
       default:
          break;
     }
 } /* genStmt */
 
-/* Procedure genExp generates code at an expression node */
-static void genExp( TreeNode * tree)
+static void genNode( TreeNode * tree, int phase);
+
+/* Function need returns the number of temporary
+ * registers the evaluation of expression t takes
+ * (its Sethi-Ullman number); labelNode keeps it
+ * in attr.val of OpK nodes
+ */
+static int need( TreeNode * t)
+{ while (t != NULL && t->nodekind == ExpK && t->kind.exp == ConvK)
+    t = t->child[0];
+  if (t == NULL || t->nodekind != ExpK || t->kind.exp != OpK) return 0;
+  return t->attr.val;
+}
+
+/* Procedure labelNode labels each OpK node with
+ * the registers it needs: the operand needing
+ * more is evaluated first, and the other one is
+ * evaluated while the first is held in a register
+ */
+static void labelNode( TreeNode * t, int phase)
+{ if (phase < MAXCHILDREN) walkList(t->child[phase]);
+  else if (t->nodekind == ExpK && t->kind.exp == OpK)
+  { int l = need(t->child[0]), r = need(t->child[1]);
+    t->attr.val = (l == r) ? l+1 : (l > r ? l : r);
+  }
+}
+
+/* Procedure genFloatOp generates code for float
+ * operation op on registers left and right; a
+ * comparison tests the sign of CMPF like the
+ * integer ones test that of SUB
+ */
+static void genFloatOp( TokenType op, int left, int right)
+{ switch (op) {
+    case PLUS :
+      emitRO("ADDF",ac,left,right,"op + (float)");
+      break;
+    case MINUS :
+      emitRO("SUBF",ac,left,right,"op - (float)");
+      break;
+    case TIMES :
+      emitRO("MULF",ac,left,right,"op * (float)");
+      break;
+    case DIV :
+      emitRO("DIVF",ac,left,right,"op / (float)");
+      break;
+    case LT :
+      emitRO("CMPF",ac,left,right,"op < (float)") ;
+      emitRM("JLT",ac,2,pc,"br if true") ;
+      emitRM("LDC",ac,0,ac,"false case") ;
+      emitRM("LDA",pc,1,pc,"unconditional jmp") ;
+      emitRM("LDC",ac,1,ac,"true case") ;
+      break;
+    case EQ :
+      emitRO("CMPF",ac,left,right,"op == (float)") ;
+      emitRM("JEQ",ac,2,pc,"br if true");
+      emitRM("LDC",ac,0,ac,"false case") ;
+      emitRM("LDA",pc,1,pc,"unconditional jmp") ;
+      emitRM("LDC",ac,1,ac,"true case") ;
+      break;
+    default:
+      emitComment("BUG: Unknown operator");
+      break;
+  }
+}
+
+/* Procedure genExp generates code at an expression
+ * node, in phases like genStmt
+ */
+static void genExp( TreeNode * tree, int phase)
 { int loc;
-  TreeNode * p1, * p2;
+  int i, held, frame, savedOffset, savedRegs;
+  TreeNode * arg;
+  union { float f; int i; } bits;
   switch (tree->kind.exp) {
 
     case ConstK :
       if (TraceCode) emitComment("-> Const") ;
-      /* gen code to load integer constant using LDC */
-      emitRM("LDC",ac,tree->attr.val,0,"load const");
+      /* gen code to load constant using LDC; a float
+         is loaded as its bits */
+      if (tree->type == Float)
+      { bits.f = tree->attr.fval;
+        emitRM("LDC",ac,bits.i,0,"load float const");
+      }
+      else
+        emitRM("LDC",ac,tree->attr.val,0,"load const");
       if (TraceCode)  emitComment("<- Const") ;
       break; /* ConstK */
     
     case IdK :
       if (TraceCode) emitComment("-> Id") ;
-      loc = st_lookup(tree->attr.name);
-      emitRM("LD",ac,loc,gp,"load id value");
+      loc = tree->sym->memloc;
+      emitRM("LD",ac,loc,base(tree->sym),"load id value");
       if (TraceCode)  emitComment("<- Id") ;
       break; /* IdK */
 
     case OpK :
-         if (TraceCode) emitComment("-> Op") ;
-         p1 = tree->child[0];
-         p2 = tree->child[1];
-         /* gen code for ac = left arg */
-         cGen(p1);
-         /* gen code to push left operand */
-         emitRM("ST",ac,tmpOffset--,mp,"op: push left");
-         /* gen code for ac = right operand */
-         cGen(p2);
-         /* now load left operand */
-         emitRM("LD",ac1,++tmpOffset,mp,"op: load left");
-         switch (tree->attr.op) {
-            case PLUS :
-               emitRO("ADD",ac,ac1,ac,"op +");
-               break;
-            case MINUS :
-               emitRO("SUB",ac,ac1,ac,"op -");
-               break;
-            case TIMES :
-               emitRO("MUL",ac,ac1,ac,"op *");
-               break;
-            case DIV :
-               emitRO("DIV",ac,ac1,ac,"op /");
-               break;
-            case LT :
-               emitRO("SUB",ac,ac1,ac,"op <") ;
-               emitRM("JLT",ac,2,pc,"br if true") ;
-               emitRM("LDC",ac,0,ac,"false case") ;
-               emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
-               break;
-            case EQ :
-               emitRO("SUB",ac,ac1,ac,"op ==") ;
-               emitRM("JEQ",ac,2,pc,"br if true");
-               emitRM("LDC",ac,0,ac,"false case") ;
-               emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
-               break;
-            default:
-               emitComment("BUG: Unknown operator");
-               break;
-         } /* case op */
-         if (TraceCode)  emitComment("<- Op") ;
-         break; /* OpK */
+    { /* the operand needing more registers goes first */
+      int rightFirst = need(tree->child[1]) > need(tree->child[0]);
+      int left, right;
+      if (phase == 0)
+      { if (TraceCode) emitComment("-> Op") ;
+        /* gen code for ac = first operand */
+        walkList(tree->child[rightFirst]);
+      }
+      else if (phase == 1)
+      { /* gen code to hold the first operand */
+        if (++tmpRegs <= NTMPREGS)
+          emitRM("LDA",FIRSTTMP+tmpRegs-1,0,ac,"op: hold operand");
+        else
+          emitRM("ST",ac,tmpOffset--,mp,"op: push operand");
+        /* gen code for ac = second operand */
+        walkList(tree->child[!rightFirst]);
+      }
+      else
+      { /* now get the first operand */
+        int held;
+        if (tmpRegs <= NTMPREGS) held = FIRSTTMP+tmpRegs-1;
+        else
+        { emitRM("LD",ac1,++tmpOffset,mp,"op: load operand");
+          held = ac1;
+        }
+        tmpRegs--;
+        left = rightFirst ? ac : held;
+        right = rightFirst ? held : ac;
+        if (tree->child[0]->type == Float)
+          genFloatOp(tree->attr.op,left,right);
+        else switch (tree->attr.op) {
+           case PLUS :
+              emitRO("ADD",ac,left,right,"op +");
+              break;
+           case MINUS :
+              emitRO("SUB",ac,left,right,"op -");
+              break;
+           case TIMES :
+              emitRO("MUL",ac,left,right,"op *");
+              break;
+           case DIV :
+              emitRO("DIV",ac,left,right,"op /");
+              break;
+           case LT :
+              emitRO("SUB",ac,left,right,"op <") ;
+              emitRM("JLT",ac,2,pc,"br if true") ;
+              emitRM("LDC",ac,0,ac,"false case") ;
+              emitRM("LDA",pc,1,pc,"unconditional jmp") ;
+              emitRM("LDC",ac,1,ac,"true case") ;
+              break;
+           case EQ :
+              emitRO("SUB",ac,left,right,"op ==") ;
+              emitRM("JEQ",ac,2,pc,"br if true");
+              emitRM("LDC",ac,0,ac,"false case") ;
+              emitRM("LDA",pc,1,pc,"unconditional jmp") ;
+              emitRM("LDC",ac,1,ac,"true case") ;
+              break;
+           default:
+              emitComment("BUG: Unknown operator");
+              break;
+        } /* case op */
+        if (TraceCode)  emitComment("<- Op") ;
+      }
+      break; /* OpK */
+    }
+
+    case ConvK :
+      if (phase == 0) walkList(tree->child[0]);
+      else if (tree->type == Float && tree->child[0]->type != Float)
+        emitRO("ITOF",ac,ac,0,"convert to float");
+      else if (tree->type != Float && tree->child[0]->type == Float)
+        emitRO("FTOI",ac,ac,0,"convert to integer");
+      break; /* ConvK */
+
+    case ArrayK :
+      if (phase == 0)
+      { if (TraceCode) emitComment("-> Array") ;
+        /* gen code for ac = index */
+        walkList(tree->child[0]);
+      }
+      else
+      { /* the index is not checked against the size */
+        loc = tree->sym->memloc;
+        if (base(tree->sym) != gp)
+          emitRO("ADD",ac,mp,ac,"array: address in frame");
+        emitRM("LD",ac,loc,ac,"load element value");
+        if (TraceCode)  emitComment("<- Array") ;
+      }
+      break; /* ArrayK */
+
+    case CallK :
+      if (TraceCode) emitComment("-> Call") ;
+      /* the callee may use the registers held */
+      held = tmpRegs < NTMPREGS ? tmpRegs : NTMPREGS;
+      for (i = 0; i < held; i++)
+        emitRM("ST",FIRSTTMP+i,tmpOffset--,mp,"call: save held operand");
+      /* the callee's frame goes below the temps;
+         the arguments are stored into it as they
+         are evaluated, each walked on its own */
+      frame = tmpOffset - tree->sym->size + 1;
+      savedOffset = tmpOffset;
+      savedRegs = tmpRegs;
+      tmpOffset = frame - 1;
+      tmpRegs = 0;
+      loc = frame + FRAMEHDR;
+      for (arg = tree->child[0]; arg != NULL; arg = arg->sibling)
+      { TreeNode * next = arg->sibling;
+        arg->sibling = NULL;
+        walkTree(arg,genNode);
+        arg->sibling = next;
+        emitRM("ST",ac,loc++,mp,"call: store argument");
+      }
+      tmpOffset = savedOffset;
+      tmpRegs = savedRegs;
+      emitRM("ST",mp,frame+1,mp,"call: save mp");
+      emitRM("LDA",mp,frame,mp,"call: mp to the frame");
+      emitRM("LDA",ac,2,pc,"call: return address");
+      emitRM("ST",ac,0,mp,"call: store return address");
+      if (tree->sym->memloc >= 0)
+        emitRM_Abs("LDA",pc,tree->sym->memloc,"call");
+      else
+      { addFixup(emitSkip(1),tree->sym);
+        emitComment("call: jump to function belongs here");
+      }
+      for (i = held-1; i >= 0; i--)
+        emitRM("LD",FIRSTTMP+i,++tmpOffset,mp,"call: restore held operand");
+      if (TraceCode)  emitComment("<- Call") ;
+      break; /* CallK */
 
     default:
       break;
   }
 } /* genExp */
 
-/* Procedure cGen recursively generates code by
- * tree traversal
+/* Procedure genNode is the visit procedure of
+ * the code generator's walk of the syntax tree
+ */
+static void genNode( TreeNode * tree, int phase)
+{ switch (tree->nodekind) {
+    case StmtK:
+      genStmt(tree,phase);
+      break;
+    case ExpK:
+      genExp(tree,phase);
+      break;
+    default:
+      break;
+  }
+}
+
+/* Procedure cGen generates code for tree and
+ * its siblings by an iterative tree walk
  */
 static void cGen( TreeNode * tree)
-{ if (tree != NULL)
-  { switch (tree->nodekind) {
-      case StmtK:
-        genStmt(tree);
-        break;
-      case ExpK:
-        genExp(tree);
-        break;
-      default:
-        break;
-    }
-    cGen(tree->sibling);
+{ TreeNode * t;
+  int i;
+  /* the functions come first; the code of each is
+     located when it is generated */
+  for (t = tree; t != NULL; t = t->sibling)
+    if (t->nodekind == StmtK && t->kind.stmt == FuncK)
+      t->sym->memloc = -1;
+  if (tree != NULL && tree->nodekind == StmtK && tree->kind.stmt == FuncK)
+  { mainJump = emitSkip(1);
+    emitComment("jump to program belongs here");
+  }
+  walkTree(tree,labelNode);
+  walkTree(tree,genNode);
+  for (i = 0; i < nfix; i++)
+  { emitBackup(fixLocs[i]);
+    emitRM_Abs("LDA",pc,fixSyms[i]->memloc,"call");
+  }
+  if (nfix > 0) emitRestore();
+  free(fixLocs);
+  free(fixSyms);
+  fixLocs = NULL;
+  fixSyms = NULL;
+  nfix = maxfix = 0;
+  mainJump = -1;
+}
+
+/* firstArray is the lowest frame offset of the
+ * arrays findArrays walks over
+ */
+static int firstArray;
+
+static void findArrays( TreeNode * t, int phase)
+{ if (phase < MAXCHILDREN) walkList(t->child[phase]);
+  else if (t->sym != NULL && t->sym->kind == ArraySym && t->sym->scope != 0
+           && t->sym->memloc < firstArray)
+    firstArray = t->sym->memloc;
+}
+
+/* Function irCovers is TRUE if the IR code covers
+ * every unit of the program tree (see irLower);
+ * if not, the trace says what it declined
+ */
+static int irCovers( TreeNode * tree)
+{ TreeNode * t;
+  int covered = TRUE;
+  for (t = tree; covered && t != NULL && t->nodekind == StmtK
+       && t->kind.stmt == FuncK; t = t->sibling)
+    covered = irLower(t,TRUE);
+  if (covered) covered = irLower(tree,FALSE);
+  irFree();
+  if (!covered && TraceCode)
+    fprintf(listing,"IR code declined at line %d: %s; "
+            "generating code from the syntax tree\n",
+            irDeclinedLine,irDeclined);
+  return covered;
+}
+
+/* Procedure irUnit generates code for a unit of
+ * the program tree through the optimized IR code
+ */
+static void irUnit( TreeNode * tree, int function)
+{ irLower(tree,function);
+  toSSA();
+  optimize(OptLevel);
+  if (TraceCode)
+  { if (function)
+      fprintf(listing,"\nIR code of %s after optimization:\n",
+              atomName(tree->attr.atom));
+    else
+      fprintf(listing,"\nIR code after optimization:\n");
+    irPrint(listing);
+  }
+  fromSSA();
+  irGen();
+  irFree();
+}
+
+/* Procedure irCode generates code for tree
+ * through the optimized IR code, a unit at a
+ * time: the functions come first, as in cGen
+ */
+static void irCode( TreeNode * tree)
+{ TreeNode * t;
+  int currentLoc;
+  if (tree != NULL && tree->nodekind == StmtK && tree->kind.stmt == FuncK)
+  { mainJump = emitSkip(1);
+    emitComment("jump to program belongs here");
+  }
+  for (t = tree; t != NULL && t->nodekind == StmtK && t->kind.stmt == FuncK;
+       t = t->sibling)
+  { if (TraceCode) emitComment("-> function") ;
+    t->sym->memloc = emitSkip(0);
+    /* the IR code keeps parameters and locals in
+       registers, but loads arrays from the frame */
+    firstArray = t->sym->size;
+    walkTree(t->child[1],findArrays);
+    clearLocals(firstArray,t->sym->size - firstArray);
+    irUnit(t,TRUE);
+    if (TraceCode)  emitComment("<- function") ;
+  }
+  if (mainJump >= 0)
+  { currentLoc = emitSkip(0) ;
+    emitBackup(mainJump) ;
+    emitRM_Abs("LDA",pc,currentLoc,"jmp to program");
+    emitRestore() ;
+    mainJump = -1;
   }
+  irUnit(tree,FALSE);
 }
 
 /**********************************************/
@@ -204,9 +682,13 @@ void codeGen(TreeNode * syntaxTree, char * codefile)
    emitRM("LD",mp,0,ac,"load maxaddress from location 0");
    emitRM("ST",ac,0,ac,"clear location 0");
    emitComment("End of standard prelude.");
-   /* generate code for TINY program */
-   cGen(syntaxTree);
+   /* generate code for TINY program: through the
+      optimized IR code if it covers the program */
+   if (OptLevel > 0 && irCovers(syntaxTree)) irCode(syntaxTree);
+   else cGen(syntaxTree);
    /* finish */
    emitComment("End of execution.");
    emitRO("HALT",0,0,0,"");
+   if (Peephole) peephole();
+   emitFlush();
 }
@@ -0,0 +1,314 @@
+/****************************************************/
+/* File: charscan.c                                 */
+/* Character-run scanning kernels used by the       */
+/* scanner of the TINY compiler: a portable scalar  */
+/* version and SSE2/AVX2 versions that look at      */
+/* 16 or 32 source bytes per step                   */
+/****************************************************/
+
+#include <string.h>
+#include "charscan.h"
+
+#if (defined(__GNUC__) || defined(_MSC_VER)) && \
+    (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define CHARSCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define CHARSCAN_X86 0
+#endif
+
+/**************************************************/
+/***********   Scalar kernels          ************/
+/**************************************************/
+
+static const char* spacesScalar(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n'))
+        p++;
+    return p;
+}
+
+static const char* lettersScalar(const char* p, const char* end)
+{
+    while (p < end && (unsigned)((*p | 0x20) - 'a') < 26)
+        p++;
+    return p;
+}
+
+static const char* digitsScalar(const char* p, const char* end)
+{
+    while (p < end && (unsigned)(*p - '0') < 10)
+        p++;
+    return p;
+}
+
+static const char* rbraceScalar(const char* p, const char* end)
+{
+    const char* q = (const char*)memchr(p, '}', end - p);
+    return q == NULL ? end : q;
+}
+
+static const char* starScalar(const char* p, const char* end)
+{
+    const char* q = (const char*)memchr(p, '*', end - p);
+    return q == NULL ? end : q;
+}
+
+#if CHARSCAN_X86
+
+#ifdef _MSC_VER
+#define TARGET_SSE2
+#define TARGET_AVX2
+static int firstBit(unsigned m)
+{
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return (int)i;
+}
+#else
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define firstBit(m) __builtin_ctz(m)
+#endif
+
+/**************************************************/
+/***********   SSE2 kernels            ************/
+/**************************************************/
+
+/* Each kernel computes a mask with one bit per byte
+ * that still belongs to the run (or, for the finders,
+ * per byte that matches) and stops at the first bit
+ * that ends it
+ */
+
+TARGET_SSE2 static const char* spacesSSE2(const char* p, const char* end)
+{
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (p < end)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, sp),
+            _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, nl)));
+        unsigned bits = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFF;
+        if (bits != 0) { p += firstBit(bits); break; }
+        p += 16;
+    }
+    return p < end ? p : end;
+}
+
+TARGET_SSE2 static const char* lettersSSE2(const char* p, const char* end)
+{
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i a = _mm_set1_epi8('a');
+    const __m128i last = _mm_set1_epi8(25);
+    while (p < end)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i t = _mm_sub_epi8(_mm_or_si128(v, lower), a);
+        __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(t, last), t);
+        unsigned bits = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFF;
+        if (bits != 0) { p += firstBit(bits); break; }
+        p += 16;
+    }
+    return p < end ? p : end;
+}
+
+TARGET_SSE2 static const char* digitsSSE2(const char* p, const char* end)
+{
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i last = _mm_set1_epi8(9);
+    while (p < end)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i t = _mm_sub_epi8(v, zero);
+        __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(t, last), t);
+        unsigned bits = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFF;
+        if (bits != 0) { p += firstBit(bits); break; }
+        p += 16;
+    }
+    return p < end ? p : end;
+}
+
+TARGET_SSE2 static const char* findSSE2(const char* p, const char* end, char c)
+{
+    const __m128i key = _mm_set1_epi8(c);
+    while (p < end)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned bits = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, key));
+        if (bits != 0) { p += firstBit(bits); break; }
+        p += 16;
+    }
+    return p < end ? p : end;
+}
+
+TARGET_SSE2 static const char* rbraceSSE2(const char* p, const char* end)
+{
+    return findSSE2(p, end, '}');
+}
+
+TARGET_SSE2 static const char* starSSE2(const char* p, const char* end)
+{
+    return findSSE2(p, end, '*');
+}
+
+/**************************************************/
+/***********   AVX2 kernels            ************/
+/**************************************************/
+
+TARGET_AVX2 static const char* spacesAVX2(const char* p, const char* end)
+{
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i nl = _mm256_set1_epi8('\n');
+    while (p < end)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, tab), _mm256_cmpeq_epi8(v, nl)));
+        unsigned bits = ~(unsigned)_mm256_movemask_epi8(m);
+        if (bits != 0) { p += firstBit(bits); break; }
+        p += 32;
+    }
+    return p < end ? p : end;
+}
+
+TARGET_AVX2 static const char* lettersAVX2(const char* p, const char* end)
+{
+    const __m256i lower = _mm256_set1_epi8(0x20);
+    const __m256i a = _mm256_set1_epi8('a');
+    const __m256i last = _mm256_set1_epi8(25);
+    while (p < end)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i t = _mm256_sub_epi8(_mm256_or_si256(v, lower), a);
+        __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(t, last), t);
+        unsigned bits = ~(unsigned)_mm256_movemask_epi8(m);
+        if (bits != 0) { p += firstBit(bits); break; }
+        p += 32;
+    }
+    return p < end ? p : end;
+}
+
+TARGET_AVX2 static const char* digitsAVX2(const char* p, const char* end)
+{
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i last = _mm256_set1_epi8(9);
+    while (p < end)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i t = _mm256_sub_epi8(v, zero);
+        __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(t, last), t);
+        unsigned bits = ~(unsigned)_mm256_movemask_epi8(m);
+        if (bits != 0) { p += firstBit(bits); break; }
+        p += 32;
+    }
+    return p < end ? p : end;
+}
+
+TARGET_AVX2 static const char* findAVX2(const char* p, const char* end, char c)
+{
+    const __m256i key = _mm256_set1_epi8(c);
+    while (p < end)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned bits = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, key));
+        if (bits != 0) { p += firstBit(bits); break; }
+        p += 32;
+    }
+    return p < end ? p : end;
+}
+
+TARGET_AVX2 static const char* rbraceAVX2(const char* p, const char* end)
+{
+    return findAVX2(p, end, '}');
+}
+
+TARGET_AVX2 static const char* starAVX2(const char* p, const char* end)
+{
+    return findAVX2(p, end, '*');
+}
+
+/* cpuLevel returns 2 if the CPU and OS support AVX2,
+ * 1 if the CPU has SSE2 and 0 otherwise
+ */
+static int cpuLevel(void)
+{
+#ifdef _MSC_VER
+    int r[4];
+    int level = 0;
+    __cpuid(r, 0);
+    if (r[0] >= 1)
+    {
+        int osxsave;
+        __cpuid(r, 1);
+        if (r[3] & (1 << 26)) level = 1;
+        osxsave = (r[2] & (1 << 27)) != 0;
+        __cpuid(r, 0);
+        if (level == 1 && osxsave && r[0] >= 7 && (_xgetbv(0) & 6) == 6)
+        {
+            __cpuidex(r, 7, 0);
+            if (r[1] & (1 << 5)) level = 2;
+        }
+    }
+    return level;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return 2;
+    if (__builtin_cpu_supports("sse2")) return 1;
+    return 0;
+#endif
+}
+
+#endif /* CHARSCAN_X86 */
+
+ScanRunProc scanSpaces = spacesScalar;
+ScanRunProc scanLetters = lettersScalar;
+ScanRunProc scanDigits = digitsScalar;
+ScanRunProc scanToRBrace = rbraceScalar;
+ScanRunProc scanToStar = starScalar;
+
+static const char* kernelName = "scalar";
+
+/* Procedure initCharScan selects the AVX2, SSE2 or
+ * scalar kernels according to the running CPU
+ */
+void initCharScan(void)
+{
+#if CHARSCAN_X86
+    switch (cpuLevel())
+    {
+    case 2:
+        scanSpaces = spacesAVX2;
+        scanLetters = lettersAVX2;
+        scanDigits = digitsAVX2;
+        scanToRBrace = rbraceAVX2;
+        scanToStar = starAVX2;
+        kernelName = "avx2";
+        break;
+    case 1:
+        scanSpaces = spacesSSE2;
+        scanLetters = lettersSSE2;
+        scanDigits = digitsSSE2;
+        scanToRBrace = rbraceSSE2;
+        scanToStar = starSSE2;
+        kernelName = "sse2";
+        break;
+    default:
+        break;
+    }
+#endif
+}
+
+/* Function charScanName returns the name of the
+ * kernel set in use ("avx2", "sse2" or "scalar")
+ */
+const char* charScanName(void)
+{
+    return kernelName;
+}
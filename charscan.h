@@ -0,0 +1,38 @@
+/****************************************************/
+/* File: charscan.h                                 */
+/* Character-run scanning kernels used by the       */
+/* scanner of the TINY compiler                     */
+/****************************************************/
+
+#ifndef _CHARSCAN_H_
+#define _CHARSCAN_H_
+
+/* SCANPAD is the number of readable bytes every
+ * kernel may touch past the end of its range; the
+ * scanner pads the source buffer by this amount
+ */
+#define SCANPAD 32
+
+/* A ScanRunProc returns the first position in
+ * [p,end) that ends the run it scans, or end
+ */
+typedef const char* (*ScanRunProc)(const char* p, const char* end);
+
+/* the kernels selected by initCharScan */
+extern ScanRunProc scanSpaces;  /* skips ' ', '\t' and '\n' */
+extern ScanRunProc scanLetters; /* skips ASCII letters */
+extern ScanRunProc scanDigits;  /* skips decimal digits */
+extern ScanRunProc scanToRBrace; /* finds '}' */
+extern ScanRunProc scanToStar;  /* finds '*' */
+
+/* Procedure initCharScan selects the AVX2, SSE2 or
+ * scalar kernels according to the running CPU
+ */
+void initCharScan(void);
+
+/* Function charScanName returns the name of the
+ * kernel set in use ("avx2", "sse2" or "scalar")
+ */
+const char* charScanName(void);
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "globals.h"
 #include "code.h"
+#include "tmobj.h"
 
 /* TM location number for current instruction emission */
 static int emitLoc = 0 ;
@@ -17,11 +18,87 @@ static int emitLoc = 0 ;
    emitBackup, and emitRestore */
 static int highEmitLoc = 0;
 
+/* The code is kept in memory until emitFlush
+ * writes it in address order: the instructions
+ * by location (a backpatch overwrites its slot),
+ * and the comments with the location they go
+ * with; their text is kept in one pool
+ */
+static TmWord * words = NULL;
+static int maxwords = 0;
+
+typedef struct
+   { int loc;
+     int kind;   /* 0 = line before loc, 1 = comment of loc */
+     size_t text; /* offset in the pool */
+   } Note;
+
+static Note * notes = NULL;
+static int nnotes = 0, maxnotes = 0;
+static char * pool = NULL;
+static size_t poolsize = 0, maxpool = 0;
+
+static void noMemory(void)
+{ fprintf(listing,"Out of memory error generating code\n");
+  exit(1);
+}
+
+/* Function opCode returns the TM opcode named op */
+static int opCode( char * op )
+{ int i;
+  for (i=0;i<opRALim;++i)
+    if (tmOpName[i][0] == op[0] && strcmp(tmOpName[i],op) == 0)
+      return i;
+  emitComment("BUG: Unknown opcode");
+  return opHALT;
+}
+
+/* Procedure putWord stores the instruction at
+ * loc, growing the instruction vector
+ */
+static void putWord( int loc, char * op, int r, int s, int t, int d)
+{ if (loc >= maxwords)
+  { int i = maxwords;
+    while (maxwords <= loc) maxwords = maxwords ? 2*maxwords : 1024;
+    words = (TmWord *) realloc(words, maxwords*sizeof(TmWord));
+    if (words == NULL) noMemory();
+    for (;i<maxwords;++i) words[i].op = opEMPTY;
+  }
+  words[loc].op = (unsigned char) opCode(op);
+  words[loc].r = (unsigned char) r;
+  words[loc].s = (unsigned char) s;
+  words[loc].t = (unsigned char) t;
+  words[loc].d = d;
+}
+
+/* Procedure putComment stores comment c of the
+ * given kind for location loc
+ */
+static void putComment( int loc, int kind, char * c)
+{ size_t len = strlen(c)+1;
+  if (nnotes == maxnotes)
+  { maxnotes = maxnotes ? 2*maxnotes : 256;
+    notes = (Note *) realloc(notes, maxnotes*sizeof(Note));
+    if (notes == NULL) noMemory();
+  }
+  if (poolsize + len > maxpool)
+  { while (poolsize + len > maxpool) maxpool = maxpool ? 2*maxpool : 4096;
+    pool = (char *) realloc(pool, maxpool);
+    if (pool == NULL) noMemory();
+  }
+  memcpy(pool+poolsize, c, len);
+  notes[nnotes].loc = loc;
+  notes[nnotes].kind = kind;
+  notes[nnotes].text = poolsize;
+  nnotes++;
+  poolsize += len;
+}
+
 /* Procedure emitComment prints a comment line 
  * with comment c in the code file
  */
 void emitComment( char * c )
-{ if (TraceCode) fprintf(code,"* %s\n",c);}
+{ if (TraceCode) putComment(emitLoc,0,c);}
 
 /* Procedure emitRO emits a register-only
  * TM instruction
@@ -32,9 +109,9 @@ void emitComment( char * c )
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRO( char *op, int r, int s, int t, char *c)
-{ fprintf(code,"%3d:  %5s  %d,%d,%d ",emitLoc++,op,r,s,t);
-  if (TraceCode) fprintf(code,"\t%s",c) ;
-  fprintf(code,"\n") ;
+{ putWord(emitLoc,op,r,s,t,0);
+  if (TraceCode) putComment(emitLoc,1,c);
+  emitLoc++;
   if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
 } /* emitRO */
 
@@ -47,9 +124,9 @@ void emitRO( char *op, int r, int s, int t, char *c)
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRM( char * op, int r, int d, int s, char *c)
-{ fprintf(code,"%3d:  %5s  %d,%d(%d) ",emitLoc++,op,r,d,s);
-  if (TraceCode) fprintf(code,"\t%s",c) ;
-  fprintf(code,"\n") ;
+{ putWord(emitLoc,op,r,s,0,d);
+  if (TraceCode) putComment(emitLoc,1,c);
+  emitLoc++;
   if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
 } /* emitRM */
 
@@ -88,10 +165,142 @@ void emitRestore(void)
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRM_Abs( char *op, int r, int a, char * c)
-{ fprintf(code,"%3d:  %5s  %d,%d(%d) ",
-               emitLoc,op,r,a-(emitLoc+1),pc);
+{ putWord(emitLoc,op,r,pc,0,a-(emitLoc+1));
+  if (TraceCode) putComment(emitLoc,1,c);
   ++emitLoc ;
-  if (TraceCode) fprintf(code,"\t%s",c) ;
-  fprintf(code,"\n") ;
   if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
 } /* emitRM_Abs */
+
+/* Function codeBuffer returns the instructions
+ * emitted so far, indexed by location, and sets
+ * *size to their number; a pass may change them
+ * in place before emitFlush
+ */
+TmWord * codeBuffer( int * size )
+{ *size = highEmitLoc;
+  return words;
+}
+
+/* Procedure codeCompact removes the empty
+ * locations from the code buffer, moving the
+ * code up; references to a removed location go
+ * to the next instruction
+ */
+void codeCompact(void)
+{ int * newLoc = (int *) malloc((highEmitLoc+1)*sizeof(int));
+  int loc, n = 0, k, m = 0;
+  if (newLoc == NULL) noMemory();
+  /* newLoc[loc] is where loc moves, or where the
+     first instruction after it moves if it is empty */
+  for (loc=0;loc<highEmitLoc;++loc)
+  { newLoc[loc] = n;
+    if (words[loc].op != opEMPTY) n++;
+  }
+  newLoc[highEmitLoc] = n;
+  /* the comments of removed instructions go too */
+  for (k=0;k<nnotes;++k)
+  { loc = notes[k].loc;
+    if (notes[k].kind == 1 && words[loc].op == opEMPTY) continue;
+    notes[m] = notes[k];
+    notes[m++].loc = newLoc[loc];
+  }
+  nnotes = m;
+  for (loc=0;loc<highEmitLoc;++loc)
+    if (words[loc].op != opEMPTY)
+    { TmWord w = words[loc];
+      int target = loc+1+w.d;
+      if (pcRelative(w) && target >= 0 && target <= highEmitLoc)
+        w.d = newLoc[target] - (newLoc[loc]+1);
+      words[newLoc[loc]] = w;
+    }
+  for (loc=n;loc<highEmitLoc;++loc) words[loc].op = opEMPTY;
+  free(newLoc);
+  highEmitLoc = emitLoc = n;
+}
+
+/* Procedure sortNotes orders the comments by
+ * location, keeping the order of emission
+ * among comments of the same location
+ */
+static void sortNotes(void)
+{ int * start = (int *) calloc(highEmitLoc+2, sizeof(int));
+  Note * sorted = (Note *) malloc((nnotes+1)*sizeof(Note));
+  int i, loc;
+  if (start == NULL || sorted == NULL) noMemory();
+  for (i=0;i<nnotes;++i) start[notes[i].loc+1]++;
+  for (loc=0;loc<=highEmitLoc;++loc) start[loc+1] += start[loc];
+  for (i=0;i<nnotes;++i) sorted[start[notes[i].loc]++] = notes[i];
+  free(start);
+  free(notes);
+  notes = sorted;
+  maxnotes = nnotes+1;
+}
+
+/* Procedure writeText writes the code as text,
+ * one line per instruction or comment
+ */
+static void writeText(void)
+{ int loc, k = 0, e;
+  for (loc=0;loc<=highEmitLoc;++loc)
+  { TmWord * w;
+    char * c = NULL;
+    /* the comments of loc are notes k..e-1 */
+    for (e=k;e<nnotes && notes[e].loc == loc;++e)
+      if (notes[e].kind == 0) fprintf(code,"* %s\n",pool+notes[e].text);
+      else c = pool+notes[e].text;
+    k = e;
+    if (loc == highEmitLoc || words[loc].op == opEMPTY) continue;
+    w = &words[loc];
+    if (w->op < opRRLim)
+      fprintf(code,"%3d:  %5s  %d,%d,%d ",loc,tmOpName[w->op],w->r,w->s,w->t);
+    else
+      fprintf(code,"%3d:  %5s  %d,%d(%d) ",loc,tmOpName[w->op],w->r,w->d,w->s);
+    if (c != NULL) fprintf(code,"\t%s",c);
+    fprintf(code,"\n");
+  }
+}
+
+/* Procedure writeBinary writes the code in the
+ * object format of tmobj.h: header, instructions
+ * (a location never emitted holds HALT) and
+ * comments
+ */
+static void writeBinary(void)
+{ TmHeader h;
+  TmComment rec;
+  static char pad[4];
+  int loc, k;
+  h.magic = TMOBJ_MAGIC;
+  h.version = TMOBJ_VERSION;
+  h.size = highEmitLoc;
+  h.ncomments = nnotes;
+  for (loc=0;loc<highEmitLoc;++loc)
+    if (words[loc].op == opEMPTY)
+    { words[loc].op = opHALT;
+      words[loc].r = words[loc].s = words[loc].t = 0;
+      words[loc].d = 0;
+    }
+  fwrite(&h, sizeof(TmHeader), 1, code);
+  fwrite(words, sizeof(TmWord), highEmitLoc, code);
+  for (k=0;k<nnotes;++k)
+  { rec.loc = notes[k].loc;
+    rec.kind = notes[k].kind;
+    rec.len = (int) strlen(pool+notes[k].text);
+    fwrite(&rec, sizeof(TmComment), 1, code);
+    fwrite(pool+notes[k].text, 1, rec.len, code);
+    fwrite(pad, 1, (4 - rec.len%4) % 4, code);
+  }
+}
+
+/* Procedure emitFlush writes the code kept in
+ * memory to the code file in address order,
+ * as text or (BinaryCode) as object code
+ */
+void emitFlush(void)
+{ sortNotes();
+  if (BinaryCode) writeBinary();
+  else writeText();
+  free(words); words = NULL; maxwords = 0;
+  free(notes); notes = NULL; nnotes = maxnotes = 0;
+  free(pool); pool = NULL; poolsize = maxpool = 0;
+} /* emitFlush */
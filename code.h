@@ -9,6 +9,8 @@
 #ifndef _CODE_H_
 #define _CODE_H_
 
+#include "tmobj.h"
+
 /* pc = program counter  */
 #define  pc 7
 
@@ -83,4 +85,36 @@ void emitRestore(void);
  */
 void emitRM_Abs( char *op, int r, int a, char * c);
 
+/* Function codeBuffer returns the instructions
+ * emitted so far, indexed by location, and sets
+ * *size to their number; a pass may change them
+ * in place before emitFlush
+ */
+TmWord * codeBuffer( int * size );
+
+/* opEMPTY is the opcode of a location holding no
+ * instruction: one never emitted, or removed by
+ * a pass over the code buffer
+ */
+#define opEMPTY opRALim
+
+/* pcRelative(w) is TRUE if instruction w refers
+ * to the code location w.d+1 past its own
+ */
+#define pcRelative(w) ((w).s == pc && ((w).op == opLDA || \
+                       ((w).op >= opJLT && (w).op <= opJNE)))
+
+/* Procedure codeCompact removes the empty
+ * locations from the code buffer, moving the
+ * code up; references to a removed location go
+ * to the next instruction
+ */
+void codeCompact(void);
+
+/* Procedure emitFlush writes the code kept in
+ * memory to the code file in address order,
+ * as text or (BinaryCode) as object code
+ */
+void emitFlush(void);
+
 #endif
@@ -0,0 +1,178 @@
+/****************************************************/
+/* File: fold.c                                     */
+/* Expression simplifier for the TINY compiler      */
+/* Works on the syntax tree after type checking,    */
+/* so the operands of every OpK node have the same  */
+/* type (analyze inserts ConvK nodes where needed)  */
+/****************************************************/
+
+#include <limits.h>
+#include "globals.h"
+#include "util.h"
+#include "fold.h"
+
+/* counts for the trace */
+static int folded = 0;     /* nodes replaced by constants */
+static int identities = 0; /* nodes replaced by an operand */
+
+static int isConst( TreeNode * t)
+{ return t != NULL && t->nodekind == ExpK && t->kind.exp == ConstK;
+}
+
+/* Function isValue is TRUE if t is the constant v */
+static int isValue( TreeNode * t, int v)
+{ if (!isConst(t)) return FALSE;
+  if (t->type == Float) return t->attr.fval == (float) v;
+  return t->attr.val == v;
+}
+
+/* Procedure makeConst turns node t into a constant
+ * of the given type
+ */
+static void makeConst( TreeNode * t, ExpType type, int val, float fval)
+{ int i;
+  for (i=0;i<MAXCHILDREN;++i) t->child[i] = NULL;
+  t->nodekind = ExpK;
+  t->kind.exp = ConstK;
+  t->type = type;
+  t->attr.val = val;
+  t->attr.fval = fval;
+  folded++;
+}
+
+/* Procedure replace puts operand x in the place
+ * of node t
+ */
+static void replace( TreeNode * t, TreeNode * x)
+{ TreeNode * sibling = t->sibling;
+  *t = *x;
+  t->sibling = sibling;
+  identities++;
+}
+
+/* Function pure is TRUE if expression t has no
+ * effect besides its value: it calls no function
+ * and does not divide, which may stop the machine
+ */
+static int pure( TreeNode * t)
+{ int i;
+  if (t == NULL) return TRUE;
+  if (t->nodekind != ExpK || t->kind.exp == CallK) return FALSE;
+  if (t->kind.exp == OpK && t->attr.op == DIV) return FALSE;
+  for (i=0;i<MAXCHILDREN;++i)
+    if (!pure(t->child[i])) return FALSE;
+  return TRUE;
+}
+
+/* Function sameVar is TRUE if a and b are the
+ * same simple variable
+ */
+static int sameVar( TreeNode * a, TreeNode * b)
+{ return a->nodekind == ExpK && a->kind.exp == IdK
+      && b->nodekind == ExpK && b->kind.exp == IdK
+      && a->sym == b->sym;
+}
+
+/* Procedure foldInt folds an integer operation
+ * of constants; the arithmetic wraps around like
+ * that of TM, and a division by 0 or of INT_MIN
+ * by -1 is left for the machine to report
+ */
+static void foldInt( TreeNode * t, int a, int b)
+{ unsigned ua = (unsigned) a, ub = (unsigned) b;
+  switch (t->attr.op)
+  { case PLUS:  makeConst(t,Integer,(int)(ua+ub),0); break;
+    case MINUS: makeConst(t,Integer,(int)(ua-ub),0); break;
+    case TIMES: makeConst(t,Integer,(int)(ua*ub),0); break;
+    case DIV:
+      if (b != 0 && !(a == INT_MIN && b == -1))
+        makeConst(t,Integer,a/b,0);
+      break;
+    case LT:    makeConst(t,Boolean,a < b,0); break;
+    case EQ:    makeConst(t,Boolean,a == b,0); break;
+    default:    break;
+  }
+}
+
+/* Procedure foldFloat folds a float operation
+ * of constants
+ */
+static void foldFloat( TreeNode * t, float a, float b)
+{ switch (t->attr.op)
+  { case PLUS:  makeConst(t,Float,0,a+b); break;
+    case MINUS: makeConst(t,Float,0,a-b); break;
+    case TIMES: makeConst(t,Float,0,a*b); break;
+    case DIV:   if (b != 0) makeConst(t,Float,0,a/b); break;
+    case LT:    makeConst(t,Boolean,a < b,0); break;
+    case EQ:    makeConst(t,Boolean,a == b,0); break;
+    default:    break;
+  }
+}
+
+/* Procedure simplifyOp folds or simplifies the
+ * OpK node t, whose operands are simplified
+ */
+static void simplifyOp( TreeNode * t)
+{ TreeNode * l = t->child[0], * r = t->child[1];
+  if (l == NULL || r == NULL || l->type != r->type) return;
+  if (isConst(l) && isConst(r))
+  { if (l->type == Float) foldFloat(t,l->attr.fval,r->attr.fval);
+    else if (l->type == Integer) foldInt(t,l->attr.val,r->attr.val);
+    return;
+  }
+  switch (t->attr.op)
+  { case PLUS:
+      if (isValue(r,0)) replace(t,l);
+      else if (isValue(l,0)) replace(t,r);
+      break;
+    case MINUS:
+      if (isValue(r,0)) replace(t,l);
+      else if (t->type == Integer && sameVar(l,r))
+        makeConst(t,Integer,0,0);
+      break;
+    case TIMES:
+      if (isValue(r,1)) replace(t,l);
+      else if (isValue(l,1)) replace(t,r);
+      else if (t->type == Integer && (isValue(r,0) || isValue(l,0))
+               && pure(l) && pure(r))
+        makeConst(t,Integer,0,0);
+      break;
+    case DIV:
+      if (isValue(r,1)) replace(t,l);
+      break;
+    default:
+      break;
+  }
+}
+
+/* Procedure simplifyConv folds the conversion of
+ * a constant
+ */
+static void simplifyConv( TreeNode * t)
+{ TreeNode * c = t->child[0];
+  if (!isConst(c)) return;
+  if (t->type == Float && c->type == Integer)
+    makeConst(t,Float,0,(float) c->attr.val);
+  else if (t->type == Integer && c->type == Float)
+    makeConst(t,Integer,(int) c->attr.fval,0);
+}
+
+static void simplifyNode( TreeNode * t, int phase)
+{ if (phase < MAXCHILDREN) walkList(t->child[phase]);
+  else if (t->nodekind == ExpK)
+  { if (t->kind.exp == OpK) simplifyOp(t);
+    else if (t->kind.exp == ConvK) simplifyConv(t);
+  }
+}
+
+/* Procedure simplify folds constant expressions
+ * and applies algebraic identities in the
+ * analyzed syntax tree, rewriting nodes in place
+ */
+void simplify( TreeNode * syntaxTree)
+{ folded = identities = 0;
+  walkTree(syntaxTree,simplifyNode);
+  if (TraceAnalyze)
+    fprintf(listing,"\nSimplification: %d nodes folded, %d identities applied\n",
+            folded,identities);
+}
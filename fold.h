@@ -0,0 +1,16 @@
+/****************************************************/
+/* File: fold.h                                     */
+/* Expression simplifier interface for the TINY     */
+/* compiler (runs between analysis and codeGen)     */
+/****************************************************/
+
+#ifndef _FOLD_H_
+#define _FOLD_H_
+
+/* Procedure simplify folds constant expressions
+ * and applies algebraic identities in the
+ * analyzed syntax tree, rewriting nodes in place
+ */
+void simplify(TreeNode *);
+
+#endif
@@ -0,0 +1,348 @@
+/****************************************************/
+/* File: gentest.c                                  */
+/* Writes a random TINY program of functions with   */
+/* parameters, locals, arrays and calls to stdout,  */
+/* for the code test, which compares the output of  */
+/* the program compiled at every level; with -f it  */
+/* filters the output of TM to the values written   */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* TINY names are letters only. The first parameter
+ * d of every function is a depth, which is never
+ * assigned and which recursive calls count down,
+ * so that every call returns
+ */
+static char* funcs[] = { "fa","fb","fc","fd" };
+#define NFUNCS ((int)(sizeof(funcs) / sizeof(funcs[0])))
+static char* params[] = { "d","p","q" };
+#define MAXPARAMS ((int)(sizeof(params) / sizeof(params[0])))
+
+/* loops run at most LOOPMAX times, so a loop
+ * counter always indexes an array of ARRAYSIZE
+ */
+#define MAXLOOPS 2
+#define LOOPMAX 4
+#define ARRAYSIZE 8
+
+/* calls made by a function body, and by the
+ * program; none are made in loops, which keeps
+ * the running time small
+ */
+#define FUNCCALLS 2
+#define MAINCALLS 6
+
+static char* globals[] = { "g","h","u","v" };
+#define NGLOBALS ((int)(sizeof(globals) / sizeof(globals[0])))
+
+/* the locals of every function, besides its array t
+ * and its loop counters i and j; the program has
+ * the array w and the loop counters m and n
+ */
+static char* locals[] = { "a","b" };
+#define NLOCALS ((int)(sizeof(locals) / sizeof(locals[0])))
+
+static int nparams[NFUNCS];
+
+/* the function being written, -1 in the program */
+static int curFunc;
+
+/* loops around the statement being written */
+static int loops;
+
+/* calls left to the body being written */
+static int calls;
+
+static int indentno = 0;
+
+/* a fixed linear congruential generator, so that
+ * every platform writes the same program
+ */
+static unsigned long seed = 1;
+
+static int rnd(int n)
+{
+    seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    return (int)((seed >> 8) % (unsigned long)n);
+}
+
+static void indent(void)
+{
+    int i;
+    for (i = 0; i < indentno; ++i) printf("  ");
+}
+
+/* the loop counter of nesting level n */
+static void counter(int n)
+{
+    printf("%c", (curFunc < 0 ? "mn" : "ij")[n]);
+}
+
+/* variable returns an integer variable that may be
+ * assigned: a global, a local or a parameter other
+ * than the depth; in the program also x
+ */
+static char* variable(void)
+{
+    int r;
+    if (curFunc < 0)
+    {
+        r = rnd(NGLOBALS + 1);
+        return r < NGLOBALS ? globals[r] : "x";
+    }
+    r = rnd(NGLOBALS + NLOCALS + nparams[curFunc] - 1);
+    if (r < NGLOBALS) return globals[r];
+    if ((r -= NGLOBALS) < NLOCALS) return locals[r];
+    return params[r - NLOCALS + 1];
+}
+
+static void expression(int depth);
+
+/* call writes a call of an earlier function, or a
+ * recursive call of the function being written
+ */
+static void call(int depth)
+{
+    int f = curFunc < 0 ? rnd(NFUNCS) : rnd(curFunc + 1);
+    int i;
+    --calls;
+    /* the first argument is a factor */
+    if (f == curFunc) printf("%s((d - 1)", funcs[f]);
+    else printf("%s(%d", funcs[f], rnd(3));
+    for (i = 1; i < nparams[f]; ++i)
+    {
+        printf(", ");
+        expression(depth);
+    }
+    printf(")");
+}
+
+/* expression writes an integer expression; the
+ * divisor of a quotient is a square plus one,
+ * which is neither 0 nor -1 even when the square
+ * wraps around, and an array is
+ * indexed by a loop counter or a constant
+ */
+static void expression(int depth)
+{
+    int r = depth > 0 ? rnd(11) : rnd(4);
+    switch (r)
+    {
+    case 0:
+        printf("%d", rnd(100));
+        break;
+    case 1:
+    case 2:
+        printf("%s", curFunc >= 0 && rnd(4) == 0 ? "d" : variable());
+        break;
+    case 3:
+        printf("%s[", curFunc < 0 ? "w" : "t");
+        if (loops > 0 && rnd(2) == 0) counter(rnd(loops));
+        else printf("%d", rnd(ARRAYSIZE));
+        printf("]");
+        break;
+    case 4:
+        if (calls > 0 && loops == 0)
+        {
+            call(depth - 1);
+            break;
+        }
+        /* otherwise a sum; fall through */
+    case 5:
+    case 6:
+    case 7:
+    case 8:
+        printf("(");
+        expression(depth - 1);
+        printf(r == 7 ? " - " : r == 8 ? " * " : " + ");
+        expression(depth - 1);
+        printf(")");
+        break;
+    default:
+    {
+        char* v = variable();
+        printf("(");
+        expression(depth - 1);
+        printf(" / (%s * %s + 1))", v, v);
+        break;
+    }
+    }
+}
+
+static void condition(void)
+{
+    expression(2);
+    printf(rnd(2) ? " < " : " = ");
+    expression(2);
+}
+
+static void sequence(int n, int depth, int more);
+
+/* statement writes a statement at the current
+ * indentation, without the semicolon after it
+ */
+static void statement(int depth)
+{
+    int r = depth > 0 ? rnd(9) : rnd(3);
+    int n = rnd(LOOPMAX) + 1;
+    if (r >= 6 && loops == MAXLOOPS) r = 0;
+    if (r == 8 && curFunc < 0) r = 3;
+    indent();
+    switch (r)
+    {
+    case 0:
+    case 1:
+        printf("%s := ", variable());
+        expression(3);
+        break;
+    case 2:
+        printf("write ");
+        expression(3);
+        break;
+    case 3:
+    case 4:
+    case 5:
+        printf("if ");
+        condition();
+        printf(" then\n");
+        sequence(rnd(3) + 1, depth - 1, 0);
+        if (r == 5)
+        {
+            indent();
+            printf("else\n");
+            sequence(rnd(3) + 1, depth - 1, 0);
+        }
+        indent();
+        printf("end");
+        break;
+    case 6:
+        counter(loops);
+        printf(" := 0;\n");
+        indent();
+        printf("while (");
+        counter(loops);
+        printf(" < %d)\n", n);
+        ++loops;
+        sequence(rnd(3) + 1, depth - 1, 1);
+        --loops;
+        ++indentno;
+        indent();
+        counter(loops);
+        printf(" := ");
+        counter(loops);
+        printf(" + 1\n");
+        --indentno;
+        indent();
+        printf("end");
+        break;
+    case 7:
+        counter(loops);
+        printf(" := 0;\n");
+        indent();
+        printf("repeat\n");
+        ++loops;
+        sequence(rnd(3) + 1, depth - 1, 1);
+        --loops;
+        ++indentno;
+        indent();
+        counter(loops);
+        printf(" := ");
+        counter(loops);
+        printf(" + 1\n");
+        --indentno;
+        indent();
+        printf("until ");
+        counter(loops);
+        printf(" = %d", n);
+        break;
+    default:
+        printf("if ");
+        condition();
+        printf(" then return ");
+        expression(2);
+        printf(" end");
+        break;
+    }
+}
+
+/* sequence writes n statements, one level deeper;
+ * a semicolon follows the last only if more
+ * statements follow the sequence
+ */
+static void sequence(int n, int depth, int more)
+{
+    ++indentno;
+    while (n-- > 0)
+    {
+        statement(depth);
+        if (n > 0 || more) printf(";");
+        printf("\n");
+    }
+    --indentno;
+}
+
+static void function(int f)
+{
+    int i;
+    curFunc = f;
+    printf("func %s(integer d", funcs[f]);
+    for (i = 1; i < nparams[f]; ++i) printf(", integer %s", params[i]);
+    printf(") integer\n");
+    printf("  integer a, b, i, j;\n");
+    printf("  integer t[%d];\n", ARRAYSIZE);
+    calls = 0;
+    printf("  if d < 1 then return ");
+    expression(2);
+    printf(" end;\n");
+    calls = FUNCCALLS;
+    sequence(rnd(4) + 2, 2, 1);
+    printf("  return ");
+    expression(3);
+    printf("\nend\n");
+}
+
+/* filter copies the values that TM writes, one to
+ * a line, the way the program run by -r writes them
+ */
+static void filter(void)
+{
+    static char prefix[] = "OUT instruction prints: ";
+    char line[256];
+    while (fgets(line, sizeof(line), stdin) != NULL)
+        if (strncmp(line, prefix, sizeof(prefix) - 1) == 0)
+            fputs(line + sizeof(prefix) - 1, stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    int f, i;
+    if (argc == 2 && strcmp(argv[1], "-f") == 0)
+    {
+        filter();
+        return 0;
+    }
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: %s [seed] | -f\n", argv[0]);
+        exit(1);
+    }
+    if (argc == 2) seed = (unsigned long)atol(argv[1]);
+    printf("{ generated test program, seed %lu }\n", seed);
+    for (f = 0; f < NFUNCS; ++f)
+        nparams[f] = rnd(MAXPARAMS) + 1;
+    for (f = 0; f < NFUNCS; ++f)
+        function(f);
+    curFunc = -1;
+    calls = MAINCALLS;
+    printf("integer w[%d];\n", ARRAYSIZE);
+    printf("read x;\n");
+    --indentno;
+    sequence(rnd(6) + 6, 3, 1);
+    ++indentno;
+    for (i = 0; i < NGLOBALS; ++i)
+        printf("write %s%s\n", globals[i], i + 1 < NGLOBALS ? ";" : "");
+    return 0;
+}
@@ -0,0 +1,60 @@
+/****************************************************/
+/* File: gentiny.c                                  */
+/* Writes a large generated TINY program to stdout, */
+/* as input for the scanner benchmark and for the   */
+/* stress test of the compiler passes               */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* the variables of the program; all are integers */
+static char* names[] =
+{
+    "x","y","fact","count","alpha","beta","gamma","delta","tmp","acc"
+};
+#define NNAMES (sizeof(names) / sizeof(names[0]))
+
+/* a fixed linear congruential generator, so that
+ * every platform writes the same program
+ */
+static unsigned long seed = 1;
+
+static int rnd(int n)
+{
+    seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    return (int)((seed >> 8) % (unsigned long)n);
+}
+
+int main(int argc, char* argv[])
+{
+    long n, i;
+    if (argc < 2 || argc > 3 || (n = atol(argv[1])) <= 0)
+    {
+        fprintf(stderr, "usage: %s <statements> [seed]\n", argv[0]);
+        exit(1);
+    }
+    if (argc == 3) seed = (unsigned long)atol(argv[2]);
+    printf("{ generated program of %ld statements }\n", n);
+    printf("read x;\n");
+    /* mostly assignments of short expressions, one
+       in ten preceded by a comment, one in ten an if
+       statement */
+    for (i = 0; i < n; ++i)
+    {
+        int a = rnd(NNAMES), b = rnd(NNAMES), c = rnd(NNAMES);
+        int r = rnd(10);
+        if (r == 0)
+            printf("/* block comment number %ld with some text */\n", i);
+        else if (r == 1)
+            printf("{ brace comment %ld }\n", i);
+        if (r == 9)
+            printf("if %s < %s then %s := %s - 1 end;\n",
+                names[a], names[b], names[a], names[a]);
+        else
+            printf("%s := %s + %s * %d;\n",
+                names[a], names[b], names[c], rnd(999) + 1);
+    }
+    printf("write x\n");
+    return 0;
+}
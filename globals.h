@@ -51,7 +51,7 @@ extern int lineno; /* 
 
 typedef enum { StmtK, ExpK } NodeKind;
 typedef enum { IfK, RepeatK, AssignK, ReadK, WriteK, FuncK, ReturnK, WhileK, DeclareK } StmtKind;
-typedef enum { OpK, ConstK, IdK, ArrayK, ParamK, CallK } ExpKind;
+typedef enum { OpK, ConstK, IdK, ArrayK, ParamK, CallK, ConvK } ExpKind;
 
 /* ͼ */
 typedef enum {
@@ -74,11 +74,13 @@ typedef struct treeNode {
     } kind;
     struct {
         TokenType op; // ExpKind = OpK
-        int val;      // ExpKind = ConstK | IdK(array)
+        int val;      // ExpKind = ConstK | IdK(array); OpK: registers needed (cgen)
         float fval;
+        int atom;     // interned name (intern.h), 0 = none
         char* name;   // ExpKind = IdK; StmtKind = AssignK | ReadK | FuncK
     } attr;
     ExpType type; /*  */ /* for type checking of exps */
+    struct SymbolRec* sym; /* symbol of the name, set by analyze */
 } TreeNode;
 
 /**************************************************/
@@ -91,6 +93,13 @@ typedef struct treeNode {
  */
 extern int EchoSource;
 
+/* TokenStream = TRUE (the -t option) causes the
+ * whole source to be tokenized into a token stream
+ * before parsing; the parser then takes lexemes from
+ * the source buffer instead of copying tokenString
+ */
+extern int TokenStream;
+
 /* TraceScan = TRUE causes token information to be
  * printed to the listing file as each token is
  * recognized by the scanner
@@ -103,6 +112,12 @@ extern int TraceScan;
  */
 extern int TraceParse;
 
+/* AnalyzeByFunction = TRUE causes each function to be
+ * analyzed as soon as the parser completes it, instead
+ * of after the whole program has been parsed
+ */
+extern int AnalyzeByFunction;
+
 /* TraceAnalyze = TRUE causes symbol table inserts
  * and lookups to be reported to the listing file
  */
@@ -113,6 +128,48 @@ extern int TraceAnalyze;
  */
 extern int TraceCode;
 
+/* BinaryCode = TRUE causes the TM code to be
+ * written in the binary object format of tmobj.h
+ * instead of as text
+ */
+extern int BinaryCode;
+
+/* NativeCode = TRUE (the -S option) causes x86-64
+ * assembly code to be generated instead of TM code
+ */
+extern int NativeCode;
+
+/* RunCode = TRUE (the -r option) causes x86-64
+ * machine code to be generated in memory and run
+ * at once, instead of written to a code file
+ */
+extern int RunCode;
+
+/* Simplify = TRUE causes constant expressions
+ * to be folded and algebraic identities applied
+ * to the syntax tree before code generation
+ */
+extern int Simplify;
+
+/* Peephole = TRUE causes the generated TM code
+ * to be improved by the peephole optimizer
+ * before it is written
+ */
+extern int Peephole;
+
+/* OptLevel > 0 (the -O option) causes the code to
+ * be generated through the IR code in SSA form,
+ * optimized at that level (1 or 2), unless the
+ * program uses floats, which the IR does not cover
+ */
+extern int OptLevel;
+
+/* TraceMemory = TRUE causes the allocation counts
+ * and peak memory use of the syntax tree arena to be
+ * printed to the listing file
+ */
+extern int TraceMemory;
+
 /* Error = TRUE prevents further passes if an error occurs */
 extern int Error;
 #endif
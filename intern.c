@@ -0,0 +1,114 @@
+/****************************************************/
+/* File: intern.c                                   */
+/* Identifier interning for the TINY compiler       */
+/* Names are kept in an open-addressing hash table  */
+/* of atoms; their strings live in the arena        */
+/****************************************************/
+
+#include "globals.h"
+#include "arena.h"
+#include "intern.h"
+
+/* atomNames[a] and atomHash[a] describe atom a */
+static char** atomNames = NULL;
+static unsigned* atomHash = NULL;
+static int atoms = 0;     /* atoms in use are 1..atoms */
+static int atomCap = 0;
+
+/* the hash table: each slot holds an atom, 0 = empty */
+static int* slots = NULL;
+static unsigned slotMask = 0;
+
+/* FNV-1a hash of len characters at s */
+static unsigned hashName(const char* s, int len)
+{
+    unsigned h = 2166136261u;
+    int i;
+    for (i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void outOfMemory(void)
+{
+    fprintf(listing, "Out of memory error at line %d\n", lineno);
+    exit(1);
+}
+
+/* growSlots doubles the hash table and reinserts
+ * every atom
+ */
+static void growSlots(void)
+{
+    unsigned size = slotMask ? (slotMask + 1) * 2 : 1024;
+    int a;
+    free(slots);
+    slots = (int*)calloc(size, sizeof(int));
+    if (slots == NULL) outOfMemory();
+    slotMask = size - 1;
+    for (a = 1; a <= atoms; a++)
+    {
+        unsigned i = atomHash[a] & slotMask;
+        while (slots[i] != 0) i = (i + 1) & slotMask;
+        slots[i] = a;
+    }
+}
+
+/* Function internName returns the atom of the len
+ * characters at s (which need not be terminated),
+ * storing a copy in the arena the first time they
+ * are seen; atoms are numbered from 1
+ */
+int internName(const char* s, int len)
+{
+    unsigned h = hashName(s, len);
+    unsigned i;
+    int a;
+    char* copy;
+    if (2 * (atoms + 1) > (int)slotMask) growSlots();
+    for (i = h & slotMask; (a = slots[i]) != 0; i = (i + 1) & slotMask)
+        if (atomHash[a] == h && !memcmp(atomNames[a], s, len) && atomNames[a][len] == '\0')
+            return a;
+    if (atoms + 1 >= atomCap)
+    {
+        atomCap = atomCap ? atomCap * 2 : 1024;
+        atomNames = (char**)realloc(atomNames, atomCap * sizeof(char*));
+        atomHash = (unsigned*)realloc(atomHash, atomCap * sizeof(unsigned));
+        if (atomNames == NULL || atomHash == NULL) outOfMemory();
+    }
+    copy = (char*)arenaAlloc(len + 1);
+    if (copy == NULL) outOfMemory();
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    a = ++atoms;
+    atomNames[a] = copy;
+    atomHash[a] = h;
+    slots[i] = a;
+    return a;
+}
+
+/* Function atomName returns the string of atom a;
+ * equal names always give the same pointer
+ */
+char* atomName(int a)
+{
+    return (a > 0 && a <= atoms) ? atomNames[a] : NULL;
+}
+
+/* Function atomCount returns the number of atoms */
+int atomCount(void)
+{
+    return atoms;
+}
+
+/* Procedure internReset forgets all atoms; it goes
+ * with arenaReset, which releases their strings
+ */
+void internReset(void)
+{
+    atoms = 0;
+    if (slots != NULL) memset(slots, 0, (slotMask + 1) * sizeof(int));
+}
@@ -0,0 +1,31 @@
+/****************************************************/
+/* File: intern.h                                   */
+/* Identifier interning for the TINY compiler:      */
+/* every distinct name is stored once and known     */
+/* by a small integer, its atom                     */
+/****************************************************/
+
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+/* Function internName returns the atom of the len
+ * characters at s (which need not be terminated),
+ * storing a copy in the arena the first time they
+ * are seen; atoms are numbered from 1
+ */
+int internName(const char* s, int len);
+
+/* Function atomName returns the string of atom a;
+ * equal names always give the same pointer
+ */
+char* atomName(int a);
+
+/* Function atomCount returns the number of atoms */
+int atomCount(void);
+
+/* Procedure internReset forgets all atoms; it goes
+ * with arenaReset, which releases their strings
+ */
+void internReset(void);
+
+#endif
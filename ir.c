@@ -0,0 +1,884 @@
+/****************************************************/
+/* File: ir.c                                       */
+/* Three-address intermediate code for the TINY     */
+/* compiler. The syntax tree is lowered to basic    */
+/* blocks without critical edges: every block with  */
+/* two successors branches to blocks with a single  */
+/* predecessor, so copies for phis can always go at */
+/* the end of a predecessor                         */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "intern.h"
+#include "symtab.h"
+#include "ir.h"
+
+IrInstr * irInstr = NULL;
+int nInstr = 0;
+static int maxInstr = 0;
+
+IrValue * irValue = NULL;
+int nValue = 0;
+static int maxValue = 0;
+
+IrBlock * irBlock = NULL;
+int nBlock = 0;
+static int maxBlock = 0;
+
+int * irOrder = NULL;
+int nOrder = 0;
+
+void irNoMemory( void )
+{ fprintf(listing,"Out of memory error in intermediate code\n");
+  exit(1);
+}
+
+/* Function grow makes room for n+1 elements of
+ * size bytes in vector v of capacity *max
+ */
+static void * grow( void * v, int n, int * max, int size )
+{ if (n == *max)
+  { *max = *max ? 2 * *max : 256;
+    v = realloc(v, (size_t) *max * size);
+    if (v == NULL) irNoMemory();
+  }
+  return v;
+}
+
+int newValue( ExpType type, int atom )
+{ IrValue * v;
+  irValue = (IrValue *) grow(irValue, nValue, &maxValue, sizeof(IrValue));
+  v = &irValue[nValue];
+  v->type = type;
+  v->atom = atom;
+  v->var = FALSE;
+  v->def = -1;
+  return nValue++;
+}
+
+int newInstr( IrOp op, int dst, int a, int b )
+{ IrInstr * i;
+  irInstr = (IrInstr *) grow(irInstr, nInstr, &maxInstr, sizeof(IrInstr));
+  i = &irInstr[nInstr];
+  i->op = op;
+  i->dst = dst;
+  i->a = a;
+  i->b = b;
+  i->val = 0;
+  i->args = NULL;
+  i->sym = NULL;
+  i->block = -1;
+  i->next = -1;
+  if (dst >= 0) irValue[dst].def = nInstr;
+  return nInstr++;
+}
+
+static int newBlock( void )
+{ IrBlock * b;
+  irBlock = (IrBlock *) grow(irBlock, nBlock, &maxBlock, sizeof(IrBlock));
+  b = &irBlock[nBlock];
+  b->first = b->last = -1;
+  b->succ[0] = b->succ[1] = -1;
+  b->pred = NULL;
+  b->npred = b->maxpred = 0;
+  b->dead = FALSE;
+  b->idom = -1;
+  b->domChild = b->domSibling = -1;
+  return nBlock++;
+}
+
+void irAppend( int b, int i )
+{ irInstr[i].block = b;
+  irInstr[i].next = -1;
+  if (irBlock[b].last < 0) irBlock[b].first = i;
+  else irInstr[irBlock[b].last].next = i;
+  irBlock[b].last = i;
+}
+
+void irPrepend( int b, int i )
+{ irInstr[i].block = b;
+  irInstr[i].next = irBlock[b].first;
+  irBlock[b].first = i;
+  if (irBlock[b].last < 0) irBlock[b].last = i;
+}
+
+/* Procedure irInsertCopies inserts the chain of
+ * instructions starting at i (linked by next)
+ * before the last instruction of block b
+ */
+void irInsertCopies( int b, int i )
+{ int last = irBlock[b].last, prev = -1, k, end = i;
+  for (k=irBlock[b].first;k!=last;k=irInstr[k].next) prev = k;
+  for (k=i;k>=0;k=irInstr[k].next)
+  { irInstr[k].block = b;
+    end = k;
+  }
+  irInstr[end].next = last;
+  if (prev < 0) irBlock[b].first = i;
+  else irInstr[prev].next = i;
+}
+
+/* Procedure addEdge adds an edge from block b to
+ * block s in the next free successor slot of b
+ */
+static void addEdge( int b, int s )
+{ IrBlock * t = &irBlock[s];
+  irBlock[b].succ[irBlock[b].succ[0] < 0 ? 0 : 1] = s;
+  t->pred = (int *) grow(t->pred, t->npred, &t->maxpred, sizeof(int));
+  t->pred[t->npred++] = b;
+}
+
+int irPredIndex( int b, int p )
+{ int k;
+  for (k=0;k<irBlock[b].npred;++k)
+    if (irBlock[b].pred[k] == p) return k;
+  return -1;
+}
+
+void irRemovePred( int b, int p )
+{ IrBlock * t = &irBlock[b];
+  int k = irPredIndex(b,p), i, j;
+  if (k < 0) return;
+  for (j=k;j+1<t->npred;++j) t->pred[j] = t->pred[j+1];
+  t->npred--;
+  for (i=t->first;i>=0;i=irInstr[i].next)
+    if (irInstr[i].op == IrPhi)
+      for (j=k;j<t->npred;++j) irInstr[i].args[j] = irInstr[i].args[j+1];
+}
+
+void irSweep( void )
+{ int b;
+  for (b=0;b<nBlock;++b)
+  { int i, prev = -1;
+    for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+      if (irInstr[i].op == IrNop)
+      { if (prev < 0) irBlock[b].first = irInstr[i].next;
+        else irInstr[prev].next = irInstr[i].next;
+        free(irInstr[i].args);
+        irInstr[i].args = NULL;
+      }
+      else prev = i;
+    irBlock[b].last = prev;
+  }
+}
+
+/* Procedure operands calls use(v,i) on each value
+ * read by instruction i
+ */
+#define operands(i,use) \
+  { IrInstr * o = &irInstr[i]; \
+    if (o->op == IrPhi) \
+    { int k_; \
+      for (k_=0;k_<irBlock[o->block].npred;++k_) use(o->args[k_],i); \
+    } \
+    else \
+    { if (o->a >= 0) use(o->a,i); \
+      if (o->b >= 0) use(o->b,i); \
+    } \
+  }
+
+static int * useStart, * useList;
+#define countUse(v,i) useStart[(v)+1]++
+#define putUse(v,i) useList[useStart[v]++] = (i)
+
+void irUses( int ** start, int ** list )
+{ int b, i, v;
+  useStart = (int *) calloc(nValue+1, sizeof(int));
+  if (useStart == NULL) irNoMemory();
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next) operands(i,countUse);
+  for (v=0;v<nValue;++v) useStart[v+1] += useStart[v];
+  useList = (int *) malloc((useStart[nValue]+1)*sizeof(int));
+  if (useList == NULL) irNoMemory();
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next) operands(i,putUse);
+  /* putUse left start[v] at the start of v+1 */
+  for (v=nValue;v>0;--v) useStart[v] = useStart[v-1];
+  useStart[0] = 0;
+  *start = useStart;
+  *list = useList;
+}
+
+/* postorder numbers of the blocks, for intersect */
+static int * po = NULL;
+
+static int intersect( int a, int b )
+{ while (a != b)
+  { while (po[a] < po[b]) a = irBlock[a].idom;
+    while (po[b] < po[a]) b = irBlock[b].idom;
+  }
+  return a;
+}
+
+/* Procedure irDominators uses the iterative
+ * algorithm of Cooper, Harvey and Kennedy on the
+ * blocks in reverse postorder
+ */
+void irDominators( void )
+{ int * stack, * next, top = 0, b, k, n = 0, changed;
+  po = (int *) realloc(po, (nBlock+1)*sizeof(int));
+  irOrder = (int *) realloc(irOrder, (nBlock+1)*sizeof(int));
+  stack = (int *) malloc((nBlock+1)*sizeof(int));
+  next = (int *) malloc((nBlock+1)*sizeof(int));
+  if (po == NULL || irOrder == NULL || stack == NULL || next == NULL)
+    irNoMemory();
+  for (b=0;b<nBlock;++b)
+  { po[b] = -1;
+    next[b] = 0;
+    irBlock[b].idom = irBlock[b].domChild = irBlock[b].domSibling = -1;
+  }
+  /* depth-first search without recursion */
+  stack[top++] = 0;
+  po[0] = 0;
+  while (top > 0)
+  { b = stack[top-1];
+    if (next[b] < 2)
+    { int s = irBlock[b].succ[next[b]++];
+      if (s >= 0 && po[s] < 0)
+      { po[s] = 0;
+        stack[top++] = s;
+      }
+    }
+    else
+    { po[b] = n;
+      irOrder[nBlock-1-n++] = b;
+      top--;
+    }
+  }
+  /* keep the reached blocks in reverse postorder */
+  nOrder = n;
+  for (k=0;k<n;++k) irOrder[k] = irOrder[nBlock-n+k];
+  for (b=0;b<nBlock;++b)
+    if (po[b] < 0 && !irBlock[b].dead)
+    { irBlock[b].dead = TRUE;
+      if (irBlock[b].succ[0] >= 0) irRemovePred(irBlock[b].succ[0],b);
+      if (irBlock[b].succ[1] >= 0) irRemovePred(irBlock[b].succ[1],b);
+    }
+  irBlock[0].idom = 0;
+  do
+  { changed = FALSE;
+    for (k=1;k<nOrder;++k)
+    { int d = -1, j;
+      b = irOrder[k];
+      for (j=0;j<irBlock[b].npred;++j)
+      { int p = irBlock[b].pred[j];
+        if (irBlock[p].idom < 0) continue;
+        d = (d < 0) ? p : intersect(p,d);
+      }
+      if (d != irBlock[b].idom)
+      { irBlock[b].idom = d;
+        changed = TRUE;
+      }
+    }
+  } while (changed);
+  /* children in reverse order, so that a walk
+     visits them in reverse postorder */
+  for (k=nOrder-1;k>0;--k)
+  { b = irOrder[k];
+    irBlock[b].domSibling = irBlock[irBlock[b].idom].domChild;
+    irBlock[irBlock[b].idom].domChild = b;
+  }
+  free(stack);
+  free(next);
+}
+
+int irCount( void )
+{ int b, i, n = 0;
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next) n++;
+  return n;
+}
+
+/* Procedure printValue prints value v: the name of
+ * its variable if it has one, and its number
+ */
+static void printValue( FILE * listing, int v )
+{ if (v < 0) fprintf(listing,"?");
+  else if (irValue[v].atom != 0)
+    fprintf(listing,"%s.%d",atomName(irValue[v].atom),v);
+  else fprintf(listing,"t%d",v);
+}
+
+void irPrint( FILE * listing )
+{ static char * opName[] =
+    { "nop", "const", "copy", "+", "-", "*", "/", "<", "==",
+      "read", "write", "load", "store", "arg", "call", "phi",
+      "jump", "branch", "ret", "halt" };
+  int b, i, k;
+  for (b=0;b<nBlock;++b)
+  { IrBlock * t = &irBlock[b];
+    if (t->dead) continue;
+    fprintf(listing,"B%d:",b);
+    if (t->npred > 0)
+    { fprintf(listing,"  preds");
+      for (k=0;k<t->npred;++k) fprintf(listing," B%d",t->pred[k]);
+    }
+    fprintf(listing,"\n");
+    for (i=t->first;i>=0;i=irInstr[i].next)
+    { IrInstr * x = &irInstr[i];
+      fprintf(listing,"    ");
+      if (x->dst >= 0)
+      { printValue(listing,x->dst);
+        fprintf(listing," := ");
+      }
+      switch (x->op)
+      { case IrConst:
+          fprintf(listing,"%d",x->val);
+          break;
+        case IrCopy:
+          printValue(listing,x->a);
+          break;
+        case IrAdd: case IrSub: case IrMul: case IrDiv:
+        case IrLt: case IrEq:
+          printValue(listing,x->a);
+          fprintf(listing," %s ",opName[x->op]);
+          printValue(listing,x->b);
+          break;
+        case IrPhi:
+          fprintf(listing,"phi(");
+          for (k=0;k<t->npred;++k)
+          { if (k > 0) fprintf(listing,", ");
+            printValue(listing,x->args[k]);
+          }
+          fprintf(listing,")");
+          break;
+        case IrWrite: case IrRet:
+          fprintf(listing,"%s ",opName[x->op]);
+          printValue(listing,x->a);
+          break;
+        case IrLoad:
+          fprintf(listing,"load %s",atomName(x->sym->atom));
+          if (x->a >= 0)
+          { fprintf(listing,"[");
+            printValue(listing,x->a);
+            fprintf(listing,"]");
+          }
+          break;
+        case IrStore:
+          fprintf(listing,"store %s, ",atomName(x->sym->atom));
+          printValue(listing,x->a);
+          break;
+        case IrArg:
+          fprintf(listing,"arg %d of %s, ",x->val,atomName(x->sym->atom));
+          printValue(listing,x->a);
+          break;
+        case IrCall:
+          fprintf(listing,"call %s",atomName(x->sym->atom));
+          break;
+        case IrJump:
+          fprintf(listing,"jump B%d",t->succ[0]);
+          break;
+        case IrBranch:
+          fprintf(listing,"if ");
+          printValue(listing,x->a);
+          fprintf(listing," goto B%d else B%d",t->succ[0],t->succ[1]);
+          break;
+        default:
+          fprintf(listing,"%s",opName[x->op]);
+          break;
+      }
+      fprintf(listing,"\n");
+    }
+  }
+}
+
+void irFree( void )
+{ int b, i;
+  for (i=0;i<nInstr;++i) free(irInstr[i].args);
+  for (b=0;b<nBlock;++b) free(irBlock[b].pred);
+  free(irInstr);
+  free(irValue);
+  free(irBlock);
+  free(irOrder);
+  free(po);
+  irInstr = NULL; irValue = NULL; irBlock = NULL;
+  irOrder = NULL; po = NULL;
+  nInstr = maxInstr = nValue = maxValue = 0;
+  nBlock = maxBlock = nOrder = 0;
+}
+
+/********************************************/
+/* lowering of the syntax tree              */
+/********************************************/
+
+/* the block being filled */
+static int cur;
+
+/* failed = TRUE once the tree is found to use
+ * something the IR does not cover
+ */
+static int failed;
+
+TreeNode * irFunc = NULL;
+char * irDeclined = NULL;
+int irDeclinedLine = 0;
+
+/* Procedure decline notes that node t uses what
+ * the IR does not cover
+ */
+static void decline( TreeNode * t, char * what )
+{ if (!failed)
+  { irDeclined = what;
+    irDeclinedLine = t->lineno;
+  }
+  failed = TRUE;
+}
+
+/* the values of the expressions being lowered and
+ * the blocks of the statements being lowered: like
+ * the saved locations of cgen.c, they are pushed in
+ * one phase of a visit and popped in a later one
+ */
+static int * stack = NULL;
+static int top = 0, maxtop = 0;
+
+static void push( int x )
+{ stack = (int *) grow(stack, top, &maxtop, sizeof(int));
+  stack[top++] = x;
+}
+
+static int pop( void )
+{ return stack[--top];
+}
+
+/* The values naming the variables, or -1: the
+ * globals by memory location in globalOf, the
+ * parameters and locals by frame offset in frameOf
+ */
+static int * globalOf = NULL, * frameOf = NULL;
+static int maxGlobal = 0, maxFrame = 0;
+
+/* Function mapEntry returns the entry of location
+ * loc in map *map of size *max, growing it
+ */
+static int * mapEntry( int ** map, int * max, int loc )
+{ if (loc >= *max)
+  { int n = *max;
+    *max = 2*loc+16;
+    *map = (int *) realloc(*map, *max*sizeof(int));
+    if (*map == NULL) irNoMemory();
+    while (n < *max) (*map)[n++] = -1;
+  }
+  return &(*map)[loc];
+}
+
+/* Function variable returns the value naming
+ * variable s, creating it with its value on entry
+ * to the unit: a parameter is loaded from the
+ * frame and a global from memory in a function,
+ * while a local starts out 0 as in cgen.c, and so
+ * does a global in the program (TM data memory
+ * starts cleared)
+ */
+static int variable( Symbol * s )
+{ int * v = (s->scope == 0) ? mapEntry(&globalOf, &maxGlobal, s->memloc)
+                            : mapEntry(&frameOf, &maxFrame, s->memloc);
+  int i;
+  if (*v < 0)
+  { *v = newValue(s->type, s->atom);
+    irValue[*v].var = TRUE;
+    if (s->kind == ParamSym || (s->scope == 0 && irFunc != NULL))
+    { i = newInstr(IrLoad, *v, -1, -1);
+      irInstr[i].sym = s;
+    }
+    else i = newInstr(IrConst, *v, -1, -1);
+    irPrepend(0, i);
+  }
+  return *v;
+}
+
+/* Function named returns the value naming the
+ * variable of node t
+ */
+static int named( TreeNode * t )
+{ Symbol * s = t->sym;
+  if (s == NULL || (s->kind != VarSym && s->kind != ParamSym))
+  { decline(t, "a name that is not a variable");
+    return -1;
+  }
+  if (s->type == Float)
+  { decline(t, "float values");
+    return -1;
+  }
+  return variable(s);
+}
+
+/* The globals the unit uses, which are in memory
+ * across its calls and returns, as functions use
+ * them too; they are written by the unit if
+ * written is TRUE. sharedOf maps their memory
+ * locations to their places in shared
+ */
+typedef struct
+   { Symbol * sym;
+     int written;
+   } Shared;
+
+static Shared * shared = NULL;
+static int nshared = 0, maxshared = 0;
+static int * sharedOf = NULL;
+static int maxSharedOf = 0;
+
+/* TRUE if the unit makes calls */
+static int makesCalls;
+
+/* Procedure noteShared is the visit procedure of
+ * the walk finding the globals of the unit; the
+ * functions of the program are units of their own
+ */
+static void noteShared( TreeNode * t, int phase )
+{ Symbol * s = t->sym;
+  int * k;
+  if (t->nodekind == StmtK
+      && (t->kind.stmt == FuncK || t->kind.stmt == DeclareK))
+    return;
+  if (phase < MAXCHILDREN) walkList(t->child[phase]);
+  if (phase == 0 && t->nodekind == ExpK && t->kind.exp == CallK)
+    makesCalls = TRUE;
+  if (phase != 0 || s == NULL || s->kind != VarSym || s->scope != 0)
+    return;
+  k = mapEntry(&sharedOf, &maxSharedOf, s->memloc);
+  if (*k < 0)
+  { shared = (Shared *) grow(shared, nshared, &maxshared, sizeof(Shared));
+    shared[nshared].sym = s;
+    shared[nshared].written = FALSE;
+    *k = nshared++;
+  }
+  /* an assignment or a read */
+  if (t->nodekind == StmtK) shared[*k].written = TRUE;
+}
+
+static int emit( IrOp op, int dst, int a, int b )
+{ int i = newInstr(op, dst, a, b);
+  irAppend(cur, i);
+  return i;
+}
+
+/* Function constant returns a new value holding
+ * constant c
+ */
+static int constant( ExpType type, int c )
+{ int d = newValue(type, 0);
+  int i = emit(IrConst, d, -1, -1);
+  irInstr[i].val = c;
+  return d;
+}
+
+/* Procedure storeShared stores the globals the
+ * unit writes, before a call or a return
+ */
+static void storeShared( void )
+{ int k, i;
+  for (k=0;k<nshared;++k)
+    if (shared[k].written)
+    { i = emit(IrStore, -1, variable(shared[k].sym), -1);
+      irInstr[i].sym = shared[k].sym;
+    }
+}
+
+/* Procedure loadShared loads the globals the unit
+ * uses after a call, which may have written them
+ */
+static void loadShared( void )
+{ int k, i;
+  for (k=0;k<nshared;++k)
+  { i = emit(IrLoad, variable(shared[k].sym), -1, -1);
+    irInstr[i].sym = shared[k].sym;
+  }
+}
+
+/* Procedure jump ends block b with a jump to t */
+static void jump( int b, int t )
+{ irAppend(b, newInstr(IrJump, -1, -1, -1));
+  addEdge(b, t);
+}
+
+/* Procedure ret ends the block with the return of
+ * value v; what follows goes to a block of its
+ * own, which nothing reaches
+ */
+static void ret( int v )
+{ storeShared();
+  emit(IrRet, -1, v, -1);
+  cur = newBlock();
+}
+
+/* Procedure call emits the call of node t, whose
+ * arguments are on the stack, and pushes its
+ * value; the arguments are passed once all are
+ * computed, as calls among them use the same frame
+ */
+static void call( TreeNode * t )
+{ TreeNode * p;
+  int n = 0, k, i, d;
+  for (p=t->child[0];p!=NULL;p=p->sibling) n++;
+  storeShared();
+  for (k=0;k<n;++k)
+  { i = emit(IrArg, -1, stack[top-n+k], -1);
+    irInstr[i].val = k;
+    irInstr[i].sym = t->sym;
+  }
+  top -= n;
+  d = newValue(t->type, 0);
+  i = emit(IrCall, d, -1, -1);
+  irInstr[i].sym = t->sym;
+  loadShared();
+  push(d);
+}
+
+/* Function need returns the number of temporary
+ * registers the evaluation of expression t takes,
+ * kept by labelNode in attr.val as in cgen.c: the
+ * operand needing more is lowered first, as cgen.c
+ * evaluates it first, so that calls are made in
+ * the same order
+ */
+static int need( TreeNode * t )
+{ while (t != NULL && t->nodekind == ExpK && t->kind.exp == ConvK)
+    t = t->child[0];
+  if (t == NULL || t->nodekind != ExpK || t->kind.exp != OpK) return 0;
+  return t->attr.val;
+}
+
+static void labelNode( TreeNode * t, int phase )
+{ if (phase < MAXCHILDREN) walkList(t->child[phase]);
+  else if (t->nodekind == ExpK && t->kind.exp == OpK)
+  { int l = need(t->child[0]), r = need(t->child[1]);
+    t->attr.val = (l == r) ? l+1 : (l > r ? l : r);
+  }
+}
+
+static void lowerStmt( TreeNode * t, int phase )
+{ int b, c, head, exit;
+  switch (t->kind.stmt)
+  { case IfK:
+      switch (phase)
+      { case 0:
+          walkList(t->child[0]);
+          break;
+        case 1:
+          c = pop();
+          emit(IrBranch, -1, c, -1);
+          b = newBlock();
+          addEdge(cur, b);
+          push(cur);
+          cur = b;
+          walkList(t->child[1]);
+          break;
+        case 2:
+          c = pop();
+          b = newBlock();
+          addEdge(c, b);
+          push(cur);
+          cur = b;
+          walkList(t->child[2]);
+          break;
+        default:
+          b = newBlock();
+          jump(pop(), b);
+          jump(cur, b);
+          cur = b;
+          break;
+      }
+      break;
+    case RepeatK:
+      switch (phase)
+      { case 0:
+          head = newBlock();
+          jump(cur, head);
+          cur = head;
+          push(head);
+          walkList(t->child[0]);
+          break;
+        case 1:
+          walkList(t->child[1]);
+          break;
+        default:
+          c = pop();
+          head = pop();
+          emit(IrBranch, -1, c, -1);
+          b = newBlock();   /* back edge */
+          exit = newBlock();
+          addEdge(cur, exit);
+          addEdge(cur, b);
+          jump(b, head);
+          cur = exit;
+          break;
+      }
+      break;
+    case WhileK:
+      switch (phase)
+      { case 0:
+          head = newBlock();
+          jump(cur, head);
+          cur = head;
+          push(head);
+          walkList(t->child[0]);
+          break;
+        case 1:
+          c = pop();
+          emit(IrBranch, -1, c, -1);
+          b = newBlock();
+          addEdge(cur, b);
+          push(cur);
+          cur = b;
+          walkList(t->child[1]);
+          break;
+        default:
+          b = pop();
+          head = pop();
+          jump(cur, head);
+          exit = newBlock();
+          addEdge(b, exit);
+          cur = exit;
+          break;
+      }
+      break;
+    case AssignK:
+      if (phase == 0) walkList(t->child[0]);
+      else
+      { c = pop();
+        emit(IrCopy, named(t), c, -1);
+      }
+      break;
+    case ReadK:
+      emit(IrRead, named(t), -1, -1);
+      break;
+    case WriteK:
+      if (phase == 0) walkList(t->child[0]);
+      else emit(IrWrite, -1, pop(), -1);
+      break;
+    case ReturnK:
+      if (phase == 0) walkList(t->child[0]);
+      else ret(pop());
+      break;
+    case DeclareK:
+      /* arrays are loaded where they are used */
+      break;
+    case FuncK:
+      /* a unit of its own */
+      break;
+    default:
+      decline(t, "this statement");
+      break;
+  }
+}
+
+static void lowerExp( TreeNode * t, int phase )
+{ int a, b, d, i;
+  IrOp op;
+  if (t->type == Float)
+  { /* IR operations are on integers only */
+    decline(t, "float values");
+    push(-1);
+    return;
+  }
+  switch (t->kind.exp)
+  { case ConstK:
+      push(constant(t->type, t->attr.val));
+      break;
+    case IdK:
+      d = named(t);
+      if (d >= 0 && makesCalls && t->sym->kind == VarSym && t->sym->scope == 0)
+      { /* a call later in the expression may write the
+           global, so its value is taken here */
+        a = d;
+        d = newValue(t->type, 0);
+        emit(IrCopy, d, a, -1);
+      }
+      push(d);
+      break;
+    case OpK:
+    { int rightFirst = need(t->child[1]) > need(t->child[0]);
+      if (phase < 2)
+      { walkList(t->child[phase ? !rightFirst : rightFirst]);
+        break;
+      }
+      b = pop();
+      a = pop();
+      if (rightFirst)
+      { d = a; a = b; b = d;
+      }
+      switch (t->attr.op)
+      { case PLUS:  op = IrAdd; break;
+        case MINUS: op = IrSub; break;
+        case TIMES: op = IrMul; break;
+        case DIV:   op = IrDiv; break;
+        case LT:    op = IrLt; break;
+        default:    op = IrEq; break;
+      }
+      d = newValue(t->type, 0);
+      emit(op, d, a, b);
+      push(d);
+      break;
+    }
+    case ArrayK:
+      if (phase == 0)
+      { walkList(t->child[0]);
+        break;
+      }
+      /* the index is not checked against the size */
+      d = newValue(t->type, 0);
+      i = emit(IrLoad, d, pop(), -1);
+      irInstr[i].sym = t->sym;
+      push(d);
+      break;
+    case CallK:
+      if (phase == 0) walkList(t->child[0]);
+      else call(t);
+      break;
+    case ConvK:
+      decline(t, "float values");
+      push(-1);
+      break;
+    default:
+      decline(t, "this expression");
+      push(-1);
+      break;
+  }
+}
+
+static void lowerNode( TreeNode * t, int phase )
+{ if (failed) return;
+  if (t->nodekind == StmtK) lowerStmt(t, phase);
+  else lowerExp(t, phase);
+}
+
+int irLower( TreeNode * tree, int function )
+{ TreeNode * body = function ? tree->child[1] : tree;
+  irFree();
+  failed = FALSE;
+  irDeclined = NULL;
+  irDeclinedLine = 0;
+  irFunc = function ? tree : NULL;
+  top = 0;
+  nshared = 0;
+  makesCalls = FALSE;
+  cur = newBlock();
+  walkTree(body, labelNode);
+  walkTree(body, noteShared);
+  walkTree(body, lowerNode);
+  /* falling off the end of a function returns 0 */
+  if (!failed && function) ret(constant(Integer, 0));
+  else if (!failed) emit(IrHalt, -1, -1, -1);
+  free(stack);
+  stack = NULL;
+  top = maxtop = 0;
+  free(globalOf);
+  free(frameOf);
+  free(sharedOf);
+  free(shared);
+  globalOf = frameOf = sharedOf = NULL;
+  shared = NULL;
+  maxGlobal = maxFrame = maxSharedOf = 0;
+  nshared = maxshared = 0;
+  if (failed)
+  { irFree();
+    return FALSE;
+  }
+  return TRUE;
+}
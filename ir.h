@@ -0,0 +1,169 @@
+/****************************************************/
+/* File: ir.h                                       */
+/* Three-address intermediate code for the TINY     */
+/* compiler: instructions, values, basic blocks     */
+/* and the lowering of the syntax tree to them      */
+/****************************************************/
+
+#ifndef _IR_H_
+#define _IR_H_
+
+/* IrOp is the operation of an IR instruction */
+typedef enum
+   { IrNop,    /* removed instruction */
+     IrConst,  /* dst = val */
+     IrCopy,   /* dst = a */
+     IrAdd, IrSub, IrMul, IrDiv, /* dst = a op b */
+     IrLt, IrEq, /* dst = a op b, 1 if true else 0 */
+     IrRead,   /* dst = integer read from input */
+     IrWrite,  /* write a */
+     IrLoad,   /* dst = sym, or element a of array sym */
+     IrStore,  /* sym = a */
+     IrArg,    /* argument val of the next call of sym = a */
+     IrCall,   /* dst = the value sym returns */
+     IrPhi,    /* dst = args[k] on entry from pred[k] */
+     IrJump,   /* go to succ[0] */
+     IrBranch, /* go to succ[0] if a != 0, else succ[1] */
+     IrRet,    /* return a from the function */
+     IrHalt    /* stop the machine */
+   } IrOp;
+
+/* An instruction; the instructions of a block are
+ * chained by next, phis first, and the last one is
+ * the jump, branch or halt ending the block
+ */
+typedef struct
+   { IrOp op;
+     int dst;    /* value defined, or -1 */
+     int a, b;   /* operand values, or -1 */
+     int val;    /* IrConst: the constant; IrPhi: its variable;
+                    IrArg: the number of the argument */
+     int * args; /* IrPhi: one value per predecessor */
+     struct SymbolRec * sym; /* IrLoad, IrStore: the variable or
+                    array; IrArg, IrCall: the function */
+     int block;
+     int next;   /* next instruction of the block, or -1 */
+   } IrInstr;
+
+/* A value is a temporary or, before SSA form is
+ * built, the name of a variable (var TRUE), which
+ * may be assigned many times
+ */
+typedef struct
+   { ExpType type;
+     int atom;   /* of the variable, 0 for a temporary */
+     int var;
+     int def;    /* defining instruction in SSA form, or -1 */
+   } IrValue;
+
+/* A basic block and its place in the control flow
+ * graph; the dominator tree is kept by irDominators
+ */
+typedef struct
+   { int first, last;  /* instructions, or -1 */
+     int succ[2];      /* successors, or -1 */
+     int * pred;       /* predecessors */
+     int npred, maxpred;
+     int dead;         /* removed as unreachable */
+     int idom;         /* immediate dominator, or -1 */
+     int domChild, domSibling; /* dominator tree, or -1 */
+   } IrBlock;
+
+/* the code of the program; block 0 is the entry */
+extern IrInstr * irInstr;
+extern int nInstr;
+extern IrValue * irValue;
+extern int nValue;
+extern IrBlock * irBlock;
+extern int nBlock;
+
+/* Function irLower translates a unit of the syntax
+ * tree to IR code: the function at FuncK node tree
+ * if function is TRUE, else the statements of the
+ * program tree outside its functions. Parameters
+ * and locals are variables of the IR; globals are
+ * too, kept in memory across calls and returns.
+ * Returns FALSE (and no code) if the unit uses what
+ * the IR does not cover, floats, with irDeclined
+ * naming it and irDeclinedLine its line
+ */
+int irLower( TreeNode * tree, int function );
+extern char * irDeclined;
+extern int irDeclinedLine;
+
+/* the function lowered by irLower, or NULL for
+ * the program
+ */
+extern TreeNode * irFunc;
+
+/* Function newValue returns a new temporary */
+int newValue( ExpType type, int atom );
+
+/* Function newInstr returns a new instruction of
+ * no block; irAppend and irPrepend place it
+ */
+int newInstr( IrOp op, int dst, int a, int b );
+
+/* Procedure irAppend adds instruction i at the end
+ * of block b, irPrepend at its start
+ */
+void irAppend( int b, int i );
+void irPrepend( int b, int i );
+
+/* Procedure irInsertCopies inserts the n chained
+ * instructions starting at i before the last
+ * instruction of block b
+ */
+void irInsertCopies( int b, int i );
+
+/* Procedure irRemovePred removes the edge from p to
+ * b from the predecessors of b and the arguments of
+ * its phis
+ */
+void irRemovePred( int b, int p );
+
+/* Function irPredIndex returns the index of p among
+ * the predecessors of b, or -1
+ */
+int irPredIndex( int b, int p );
+
+/* Procedure irSweep unlinks the IrNop instructions
+ * from their blocks
+ */
+void irSweep( void );
+
+/* Procedure irUses builds the instructions using each
+ * value: those of value v are list[start[v]] up to
+ * list[start[v+1]-1]. The caller frees both arrays
+ */
+void irUses( int ** start, int ** list );
+
+/* Procedure irDominators computes the immediate
+ * dominators and dominator tree of the live blocks;
+ * the blocks in reverse postorder are left in
+ * irOrder[0..nOrder-1], and unreachable blocks are
+ * marked dead
+ */
+void irDominators( void );
+extern int * irOrder;
+extern int nOrder;
+
+/* Function irCount returns the number of live
+ * instructions
+ */
+int irCount( void );
+
+/* Procedure irPrint prints the IR code to the
+ * listing file
+ */
+void irPrint( FILE * listing );
+
+/* Procedure irFree frees the IR code */
+void irFree( void );
+
+/* Procedure irNoMemory reports that memory ran out
+ * and stops the compiler
+ */
+void irNoMemory( void );
+
+#endif
@@ -0,0 +1,700 @@
+/****************************************************/
+/* File: irgen.c                                    */
+/* TM code generation from the IR code for the      */
+/* TINY compiler. Values live in registers FIRSTREG */
+/* and up, chosen by linear scan over their live    */
+/* ranges, or in spill slots below the frame; ac    */
+/* and ac1 are left as scratch registers, and       */
+/* constants are loaded where they are used         */
+/****************************************************/
+
+#include "globals.h"
+#include "symtab.h"
+#include "code.h"
+#include "ir.h"
+#include "irgen.h"
+
+#define FIRSTREG 2
+#define NREGS 3
+
+/* reg[v] is the register of value v, or -1;
+ * slot[v] its spill slot, or -1; konst[v] is TRUE
+ * if v is a constant, whose value is cval[v];
+ * home[v] is the frame offset of the parameter v
+ * is loaded from if that is its one definition,
+ * else -1: spilled, it stays there, as nothing
+ * writes parameters in the frame
+ */
+static int * reg, * slot, * konst, * cval, * home;
+
+/* The live ranges of each value, as positions:
+ * instruction k of the layout reads its operands
+ * at 2k and writes its result at 2k+1. Value v is
+ * live in the ranges from[k]..to[k] for k from
+ * rangeStart[v] to rangeStart[v+1]-1, in order,
+ * and in none of the holes between them; start
+ * and end are the first and last positions
+ */
+static int * rangeStart, * from, * to;
+static int nranges, maxranges;
+static int * start, * end;
+
+/* the instructions using each value */
+static int * useStart, * useList;
+
+/* pos[i] is the number of instruction i in the
+ * layout; the instructions of block b are those
+ * from first[b] to last[b]
+ */
+static int * pos, * first, * last;
+
+static void * alloc( int n, int size )
+{ void * p = malloc((size_t) (n+1) * size);
+  if (p == NULL) irNoMemory();
+  return p;
+}
+
+/* Procedure number numbers the instructions of
+ * the live blocks in block order
+ */
+static void number( void )
+{ int b, i, k = 0;
+  for (b=0;b<nBlock;++b)
+  { first[b] = k;
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next) pos[i] = k++;
+    last[b] = k-1;
+  }
+}
+
+/* Procedure addRange appends the range f..t to
+ * the ranges of value v, joining it to the last
+ * one if they touch
+ */
+static void addRange( int v, int f, int t )
+{ if (nranges > rangeStart[v] && f <= to[nranges-1]+1)
+  { if (t > to[nranges-1]) to[nranges-1] = t;
+    return;
+  }
+  if (nranges == maxranges)
+  { maxranges = maxranges ? 2*maxranges : 1024;
+    from = (int *) realloc(from, maxranges*sizeof(int));
+    to = (int *) realloc(to, maxranges*sizeof(int));
+    if (from == NULL || to == NULL) irNoMemory();
+  }
+  from[nranges] = f;
+  to[nranges++] = t;
+}
+
+static int compareInt( const void * a, const void * b )
+{ return *(const int *) a - *(const int *) b;
+}
+
+/* Procedure liveRanges computes the live ranges
+ * of each value. A value is live into the block of
+ * a use not preceded there by a definition, and
+ * then out of each predecessor and into those not
+ * defining it. In a block, it is live from the
+ * start (if live into it) or a definition to the
+ * last use before the next definition, and to the
+ * end if it is live out of the block
+ */
+static void liveRanges( void )
+{ int * defStart = (int *) calloc(nValue+1, sizeof(int));
+  int * defList, * firstDef, * defMark, * inMark, * seen, * work, * blocks;
+  int b, i, k, v, n, nb;
+  if (defStart == NULL) irNoMemory();
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+        if (irInstr[i].dst >= 0) defStart[irInstr[i].dst+1]++;
+  for (v=0;v<nValue;++v) defStart[v+1] += defStart[v];
+  defList = (int *) alloc(defStart[nValue], sizeof(int));
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+        if (irInstr[i].dst >= 0) defList[defStart[irInstr[i].dst]++] = i;
+  for (v=nValue;v>0;--v) defStart[v] = defStart[v-1];
+  defStart[0] = 0;
+  firstDef = (int *) alloc(nBlock, sizeof(int));
+  defMark = (int *) alloc(nBlock, sizeof(int));
+  inMark = (int *) alloc(nBlock, sizeof(int));
+  seen = (int *) alloc(nBlock, sizeof(int));
+  work = (int *) alloc(nBlock, sizeof(int));
+  blocks = (int *) alloc(nBlock, sizeof(int));
+  for (b=0;b<nBlock;++b) defMark[b] = inMark[b] = seen[b] = -1;
+  nranges = 0;
+  for (v=0;v<nValue;++v)
+  { int d, u, de, ue;
+    rangeStart[v] = nranges;
+    /* a constant defined once is loaded where used */
+    konst[v] = defStart[v+1]-defStart[v] == 1
+               && irInstr[defList[defStart[v]]].op == IrConst;
+    if (konst[v]) cval[v] = irInstr[defList[defStart[v]]].val;
+    home[v] = -1;
+    if (defStart[v+1]-defStart[v] == 1)
+    { IrInstr * x = &irInstr[defList[defStart[v]]];
+      if (x->op == IrLoad && x->a < 0 && x->sym->kind == ParamSym)
+        home[v] = x->sym->memloc;
+    }
+    start[v] = end[v] = -1;
+    if (konst[v] || defStart[v] == defStart[v+1]) continue;
+    nb = 0;
+    for (k=defStart[v];k<defStart[v+1];++k)
+    { int p = 2*pos[defList[k]]+1;
+      b = irInstr[defList[k]].block;
+      if (defMark[b] != v) firstDef[b] = p;
+      defMark[b] = v;
+      if (seen[b] != v) { seen[b] = v; blocks[nb++] = b; }
+    }
+    n = 0;
+    for (k=useStart[v];k<useStart[v+1];++k)
+    { int p = 2*pos[useList[k]];
+      b = irInstr[useList[k]].block;
+      if (seen[b] != v) { seen[b] = v; blocks[nb++] = b; }
+      if ((defMark[b] == v && firstDef[b] < p) || inMark[b] == v) continue;
+      inMark[b] = v;
+      work[n++] = b;
+    }
+    while (n > 0)
+    { int j;
+      b = work[--n];
+      if (seen[b] != v) { seen[b] = v; blocks[nb++] = b; }
+      for (j=0;j<irBlock[b].npred;++j)
+      { int p = irBlock[b].pred[j];
+        if (defMark[p] != v && inMark[p] != v)
+        { inMark[p] = v;
+          work[n++] = p;
+        }
+      }
+    }
+    /* the ranges, block by block in layout order;
+       the definitions and uses are in that order */
+    qsort(blocks, nb, sizeof(int), compareInt);
+    d = defStart[v]; de = defStart[v+1];
+    u = useStart[v]; ue = useStart[v+1];
+    for (k=0;k<nb;++k)
+    { int f = -1, t = -1, s0, s1;
+      b = blocks[k];
+      s0 = irBlock[b].succ[0];
+      s1 = irBlock[b].succ[1];
+      if (inMark[b] == v) f = t = 2*first[b];
+      for (;;)
+      { int pd = (d < de && irInstr[defList[d]].block == b) ? 2*pos[defList[d]]+1 : -1;
+        int pu = (u < ue && irInstr[useList[u]].block == b) ? 2*pos[useList[u]] : -1;
+        if (pd < 0 && pu < 0) break;
+        if (pu >= 0 && (pd < 0 || pu < pd))
+        { if (f < 0) f = pu;
+          t = pu;
+          u++;
+        }
+        else
+        { /* dead from the last use to a definition */
+          if (f >= 0) addRange(v, f, t);
+          f = t = pd;
+          d++;
+        }
+      }
+      if ((s0 >= 0 && inMark[s0] == v) || (s1 >= 0 && inMark[s1] == v))
+      { if (f < 0) f = 2*first[b];
+        t = 2*last[b]+1;
+      }
+      if (f >= 0) addRange(v, f, t);
+    }
+    if (nranges > rangeStart[v])
+    { start[v] = from[rangeStart[v]];
+      end[v] = to[nranges-1];
+    }
+  }
+  rangeStart[nValue] = nranges;
+  free(defStart); free(defList); free(firstDef); free(defMark);
+  free(inMark); free(seen); free(work); free(blocks);
+}
+
+/* rcur[v] is the first range of v not ended
+ * before the position of the scan
+ */
+static int * rcur;
+
+/* calls[p] counts the calls writing their result
+ * before position p
+ */
+static int * calls;
+
+/* Function acrossCall is TRUE if value v is live
+ * across a call
+ */
+static int acrossCall( int v )
+{ int k;
+  for (k=rangeStart[v];k<rangeStart[v+1];++k)
+    if (calls[to[k]+1] > calls[from[k]+1]) return TRUE;
+  return FALSE;
+}
+
+/* Function covers is TRUE if value v is live at
+ * position p, which never decreases
+ */
+static int covers( int v, int p )
+{ while (rcur[v] < rangeStart[v+1] && to[rcur[v]] < p) rcur[v]++;
+  return rcur[v] < rangeStart[v+1] && from[rcur[v]] <= p;
+}
+
+/* Function meet returns the first position at
+ * which values a and c are both live, or -1
+ */
+static int meet( int a, int c )
+{ int i = rcur[a], j = rcur[c];
+  while (i < rangeStart[a+1] && j < rangeStart[c+1])
+    if (to[i] < from[j]) i++;
+    else if (to[j] < from[i]) j++;
+    else return from[i] > from[j] ? from[i] : from[j];
+  return -1;
+}
+
+/* the spill slots in use, as a heap on the end
+ * of their values' ranges; and the free ones
+ */
+static int * heap, nheap;
+static int * freeSlot, nfree, nslots;
+
+static void heapPush( int v )
+{ int k = nheap++;
+  while (k > 0 && end[heap[(k-1)/2]] > end[v])
+  { heap[k] = heap[(k-1)/2];
+    k = (k-1)/2;
+  }
+  heap[k] = v;
+}
+
+static int heapPop( void )
+{ int top = heap[0], v = heap[--nheap], k = 0;
+  for (;;)
+  { int c = 2*k+1;
+    if (c >= nheap) break;
+    if (c+1 < nheap && end[heap[c+1]] < end[heap[c]]) c++;
+    if (end[v] <= end[heap[c]]) break;
+    heap[k] = heap[c];
+    k = c;
+  }
+  if (nheap > 0) heap[k] = v;
+  return top;
+}
+
+/* Procedure allocate assigns registers by linear
+ * scan over live ranges with holes (after Wimmer):
+ * the values are taken in order of their start; a
+ * value whose register is in a hole is inactive,
+ * and its register goes to values that end before
+ * they meet it. A value gets a register free for
+ * all of its ranges, or takes the one of an active
+ * value that ends later, which is spilled whole.
+ * A value live across a call is spilled, as the
+ * function called may use every register. Spilled
+ * values then share slots by their start and end
+ */
+static void allocate( void )
+{ int npos = 2*nInstr+2, v, k, p, j, r, b, i;
+  int * count = (int *) calloc(npos+1, sizeof(int));
+  int * order = (int *) alloc(nValue, sizeof(int));
+  int * active = (int *) alloc(nValue, sizeof(int));
+  int * inactive = (int *) alloc(nValue, sizeof(int));
+  int nactive = 0, ninactive = 0, nvalues;
+  calls = (int *) calloc(npos+2, sizeof(int));
+  if (count == NULL || calls == NULL) irNoMemory();
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+        if (irInstr[i].op == IrCall) calls[2*pos[i]+2]++;
+  for (p=0;p<=npos;++p) calls[p+1] += calls[p];
+  /* the values in order of start */
+  for (v=0;v<nValue;++v)
+    if (start[v] >= 0) count[start[v]+1]++;
+  for (p=0;p<npos;++p) count[p+1] += count[p];
+  nvalues = count[npos];
+  for (v=0;v<nValue;++v)
+  { reg[v] = slot[v] = -1;
+    rcur[v] = rangeStart[v];
+    if (start[v] >= 0) order[count[start[v]]++] = v;
+  }
+  free(count);
+  for (k=0;k<nvalues;++k)
+  { int freeUntil[NREGS], holder[NREGS], best;
+    v = order[k];
+    if (acrossCall(v)) continue;
+    p = start[v];
+    for (j=0;j<nactive;)
+    { int x = active[j];
+      if (end[x] < p) active[j] = active[--nactive];
+      else if (!covers(x, p))
+      { inactive[ninactive++] = x;
+        active[j] = active[--nactive];
+      }
+      else j++;
+    }
+    for (j=0;j<ninactive;)
+    { int x = inactive[j];
+      if (end[x] < p) inactive[j] = inactive[--ninactive];
+      else if (covers(x, p))
+      { active[nactive++] = x;
+        inactive[j] = inactive[--ninactive];
+      }
+      else j++;
+    }
+    for (r=0;r<NREGS;++r)
+    { freeUntil[r] = npos;
+      holder[r] = -1;
+    }
+    for (j=0;j<nactive;++j)
+    { freeUntil[reg[active[j]]-FIRSTREG] = 0;
+      holder[reg[active[j]]-FIRSTREG] = active[j];
+    }
+    for (j=0;j<ninactive;++j)
+    { int m = meet(inactive[j], v);
+      r = reg[inactive[j]]-FIRSTREG;
+      if (m >= 0 && m < freeUntil[r]) freeUntil[r] = m;
+      if (m >= 0) holder[r] = -2; /* cannot be freed */
+    }
+    best = 0;
+    for (r=1;r<NREGS;++r)
+      if (freeUntil[r] > freeUntil[best]) best = r;
+    if (freeUntil[best] > end[v])
+    { reg[v] = FIRSTREG+best;
+      active[nactive++] = v;
+      continue;
+    }
+    /* spill the active value ending last, if it
+       ends after v and its register is then free */
+    best = -1;
+    for (r=0;r<NREGS;++r)
+      if (holder[r] >= 0 && (best < 0 || end[holder[r]] > end[holder[best]]))
+        best = r;
+    if (best >= 0 && end[holder[best]] > end[v])
+    { int x = holder[best];
+      reg[x] = -1;
+      j = 0;
+      while (active[j] != x) j++;
+      active[j] = v;
+      reg[v] = FIRSTREG+best;
+    }
+  }
+  free(active);
+  free(inactive);
+  free(calls);
+  /* slots for the values left without a register */
+  heap = (int *) alloc(nValue, sizeof(int));
+  freeSlot = (int *) alloc(nValue, sizeof(int));
+  nheap = nfree = nslots = 0;
+  for (k=0;k<nvalues;++k)
+  { v = order[k];
+    if (reg[v] >= 0 || home[v] >= 0) continue;
+    while (nheap > 0 && end[heap[0]] < start[v])
+      freeSlot[nfree++] = slot[heapPop()];
+    slot[v] = nfree > 0 ? freeSlot[--nfree] : nslots++;
+    heapPush(v);
+  }
+  free(heap);
+  free(freeSlot);
+  free(order);
+}
+
+/* Function slotLoc returns the offset from mp of
+ * the spill slot of value v, or its home: the
+ * slots lie below the frame of a function, and
+ * from mp down in the program, like the temps of
+ * cgen.c
+ */
+static int slotLoc( int v )
+{ if (home[v] >= 0) return home[v];
+  return (irFunc != NULL ? -1 : 0) - slot[v];
+}
+
+/* Function frameLoc returns the offset from mp of
+ * the frame of a call of function f, which lies
+ * below the spill slots
+ */
+static int frameLoc( Symbol * f )
+{ return (irFunc != NULL ? -1 : 0) - nslots - f->size + 1;
+}
+
+/* Function base returns the register variable s
+ * is addressed from: gp for globals, mp for the
+ * parameters and locals in the frame
+ */
+static int base( Symbol * s )
+{ return s->scope == 0 ? gp : mp;
+}
+
+/********************************************/
+/* emission                                 */
+/********************************************/
+
+/* the code location of each block, or -1, and
+ * the jumps still to be patched
+ */
+static int * blockLoc;
+
+typedef struct
+   { int loc;
+     char * op;
+     int r;
+     int block;
+   } Fixup;
+
+static Fixup * fixups = NULL;
+static int nfixups = 0, maxfixups = 0;
+
+/* Function resolve returns the block where
+ * control goes from block b: blocks holding only
+ * a jump are passed through
+ */
+static int resolve( int b )
+{ int k;
+  for (k=0;k<nBlock;++k)
+  { int i = irBlock[b].first;
+    if (i < 0 || irInstr[i].op != IrJump) break;
+    b = irBlock[b].succ[0];
+  }
+  return b;
+}
+
+/* Procedure jumpTo emits jump op on register r
+ * to block b, patched later if b comes after
+ */
+static void jumpTo( char * op, int r, int b, char * c )
+{ if (blockLoc[b] >= 0)
+  { emitRM_Abs(op, r, blockLoc[b], c);
+    return;
+  }
+  if (nfixups == maxfixups)
+  { maxfixups = maxfixups ? 2*maxfixups : 64;
+    fixups = (Fixup *) realloc(fixups, maxfixups*sizeof(Fixup));
+    if (fixups == NULL) irNoMemory();
+  }
+  fixups[nfixups].loc = emitSkip(1);
+  fixups[nfixups].op = op;
+  fixups[nfixups].r = r;
+  fixups[nfixups++].block = b;
+}
+
+/* Function use returns the register holding
+ * value v, loading it in scratch if need be
+ */
+static int use( int v, int scratch )
+{ if (reg[v] >= 0) return reg[v];
+  if (konst[v]) emitRM("LDC", scratch, cval[v], 0, "load const");
+  else if (slot[v] >= 0 || home[v] >= 0)
+    emitRM("LD", scratch, slotLoc(v), mp, "load spilled value");
+  else emitRM("LDC", scratch, 0, 0, "undefined value");
+  return scratch;
+}
+
+/* Function target returns the register to compute
+ * value v in; store puts it in its slot if spilled.
+ * A spilled value is computed in ac1 and stored
+ * from there: the peephole optimizer takes a store
+ * of ac at mp for a push of cgen.c, loaded once
+ */
+static int target( int v )
+{ return reg[v] >= 0 ? reg[v] : ac1;
+}
+
+static void store( int v, int r )
+{ if (reg[v] < 0 && slot[v] >= 0)
+    emitRM("ST", r, slotLoc(v), mp, "store spilled value");
+}
+
+/* Procedure branch emits the jumps to block t if
+ * jump op yes is taken on register r, else to
+ * block f (op no), given the block laid out next
+ */
+static void branch( char * yes, char * no, int r, int t, int f, int next )
+{ t = resolve(t);
+  f = resolve(f);
+  if (f == next) jumpTo(yes, r, t, "br if true");
+  else if (t == next) jumpTo(no, r, f, "br if false");
+  else
+  { jumpTo(yes, r, t, "br if true");
+    jumpTo("LDA", pc, f, "jmp if false");
+  }
+}
+
+static void genInstr( int i, int next, int isLast )
+{ static char * opName[] = { "", "", "", "ADD", "SUB", "MUL", "DIV" };
+  IrInstr * x = &irInstr[i];
+  IrBlock * t = &irBlock[x->block];
+  int ra, rb, rd;
+  switch (x->op)
+  { case IrConst:
+      /* loaded where used */
+      break;
+    case IrCopy:
+      if (reg[x->dst] < 0)
+        store(x->dst, use(x->a, ac1));
+      else if (konst[x->a])
+        emitRM("LDC", reg[x->dst], cval[x->a], 0, "copy const");
+      else if (reg[x->a] < 0)
+        emitRM("LD", reg[x->dst], slotLoc(x->a), mp, "copy spilled value");
+      else if (reg[x->a] != reg[x->dst])
+        emitRM("LDA", reg[x->dst], 0, reg[x->a], "copy");
+      break;
+    case IrAdd: case IrSub: case IrMul: case IrDiv:
+      ra = use(x->a, ac);
+      rb = use(x->b, ac1);
+      rd = target(x->dst);
+      emitRO(opName[x->op], rd, ra, rb, "op");
+      store(x->dst, rd);
+      break;
+    case IrLt: case IrEq:
+      ra = use(x->a, ac);
+      rb = use(x->b, ac1);
+      emitRO("SUB", ac, ra, rb, x->op == IrLt ? "op <" : "op ==");
+      /* a comparison only tested by the branch after
+         it jumps on the difference */
+      if (x->next == t->last && irInstr[t->last].op == IrBranch
+          && irInstr[t->last].a == x->dst
+          && useStart[x->dst+1]-useStart[x->dst] == 1)
+        break;
+      rd = target(x->dst);
+      emitRM(x->op == IrLt ? "JLT" : "JEQ", ac, 2, pc, "br if true");
+      emitRM("LDC", rd, 0, 0, "false case");
+      emitRM("LDA", pc, 1, pc, "unconditional jmp");
+      emitRM("LDC", rd, 1, 0, "true case");
+      store(x->dst, rd);
+      break;
+    case IrRead:
+      rd = target(x->dst);
+      emitRO("IN", rd, 0, 0, "read integer value");
+      store(x->dst, rd);
+      break;
+    case IrWrite:
+      emitRO("OUT", use(x->a, ac), 0, 0, "write");
+      break;
+    case IrLoad:
+      if (reg[x->dst] < 0 && home[x->dst] >= 0) break;
+      rd = target(x->dst);
+      if (x->a < 0)
+        emitRM("LD", rd, x->sym->memloc, base(x->sym), "load variable");
+      else
+      { /* the index is not checked against the size */
+        ra = use(x->a, ac);
+        if (base(x->sym) != gp)
+        { emitRO("ADD", ac, mp, ra, "array: address in frame");
+          ra = ac;
+        }
+        emitRM("LD", rd, x->sym->memloc, ra, "load element value");
+      }
+      store(x->dst, rd);
+      break;
+    case IrStore:
+      emitRM("ST", use(x->a, ac1), x->sym->memloc, base(x->sym), "store variable");
+      break;
+    case IrArg:
+      emitRM("ST", use(x->a, ac1), frameLoc(x->sym)+FRAMEHDR+x->val, mp,
+             "call: store argument");
+      break;
+    case IrCall:
+      ra = frameLoc(x->sym);
+      emitRM("ST", mp, ra+1, mp, "call: save mp");
+      emitRM("LDA", mp, ra, mp, "call: mp to the frame");
+      emitRM("LDA", ac, 2, pc, "call: return address");
+      emitRM("ST", ac, 0, mp, "call: store return address");
+      /* a function is declared before it is called,
+         so its code comes first */
+      emitRM_Abs("LDA", pc, x->sym->memloc, "call");
+      if (reg[x->dst] >= 0 || slot[x->dst] >= 0)
+      { rd = target(x->dst);
+        emitRM("LDA", rd, 0, ac, "call: result");
+        store(x->dst, rd);
+      }
+      break;
+    case IrRet:
+      ra = use(x->a, ac);
+      if (ra != ac) emitRM("LDA", ac, 0, ra, "return value");
+      emitRM("LD", ac1, 0, mp, "return: load return address");
+      emitRM("LD", mp, 1, mp, "return: restore caller's mp");
+      emitRM("LDA", pc, 0, ac1, "return");
+      break;
+    case IrJump:
+      if (resolve(t->succ[0]) != next)
+        jumpTo("LDA", pc, resolve(t->succ[0]), "jmp");
+      break;
+    case IrBranch:
+    { int d = irValue[x->a].def, prev = -1, k;
+      for (k=t->first;k!=i;k=irInstr[k].next) prev = k;
+      if (prev >= 0 && prev == d && useStart[x->a+1]-useStart[x->a] == 1
+          && (irInstr[d].op == IrLt || irInstr[d].op == IrEq))
+      { if (irInstr[d].op == IrLt)
+          branch("JLT", "JGE", ac, t->succ[0], t->succ[1], next);
+        else
+          branch("JEQ", "JNE", ac, t->succ[0], t->succ[1], next);
+      }
+      else
+        branch("JNE", "JEQ", use(x->a, ac), t->succ[0], t->succ[1], next);
+      break;
+    }
+    case IrHalt:
+      /* codeGen ends the code with HALT */
+      if (!isLast) emitRO("HALT", 0, 0, 0, "");
+      break;
+    default:
+      break;
+  }
+}
+
+void irGen( void )
+{ int b, i, k, next, entry;
+  char buf[32];
+  reg = (int *) alloc(nValue, sizeof(int));
+  slot = (int *) alloc(nValue, sizeof(int));
+  konst = (int *) alloc(nValue, sizeof(int));
+  home = (int *) alloc(nValue, sizeof(int));
+  cval = (int *) alloc(nValue, sizeof(int));
+  start = (int *) alloc(nValue, sizeof(int));
+  end = (int *) alloc(nValue, sizeof(int));
+  rangeStart = (int *) alloc(nValue, sizeof(int));
+  rcur = (int *) alloc(nValue, sizeof(int));
+  pos = (int *) alloc(nInstr, sizeof(int));
+  first = (int *) alloc(nBlock, sizeof(int));
+  last = (int *) alloc(nBlock, sizeof(int));
+  blockLoc = (int *) alloc(nBlock, sizeof(int));
+  irUses(&useStart, &useList);
+  number();
+  liveRanges();
+  allocate();
+  for (b=0;b<nBlock;++b) blockLoc[b] = -1;
+  /* blocks holding only a jump take no code */
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead && resolve(b) != b) irBlock[b].dead = TRUE;
+  entry = resolve(0);
+  b = 0;
+  while (b < nBlock && irBlock[b].dead) b++;
+  if (b != entry) jumpTo("LDA", pc, entry, "jmp to entry");
+  for (b=0;b<nBlock;b=next)
+  { next = b+1;
+    while (next < nBlock && irBlock[next].dead) next++;
+    if (irBlock[b].dead) continue;
+    blockLoc[b] = emitSkip(0);
+    if (TraceCode)
+    { sprintf(buf, "block B%d", b);
+      emitComment(buf);
+    }
+    for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+      genInstr(i, next < nBlock ? next : -1, next >= nBlock);
+  }
+  for (k=0;k<nfixups;++k)
+  { emitBackup(fixups[k].loc);
+    emitRM_Abs(fixups[k].op, fixups[k].r, blockLoc[fixups[k].block],
+               fixups[k].r == pc ? "jmp" : "br");
+    emitRestore();
+  }
+  free(fixups);
+  fixups = NULL;
+  nfixups = maxfixups = 0;
+  free(reg); free(slot); free(konst); free(cval); free(home);
+  free(start); free(end); free(rangeStart); free(rcur);
+  free(from); free(to);
+  from = to = NULL;
+  nranges = maxranges = 0;
+  free(pos); free(first); free(last);
+  free(blockLoc); free(useStart); free(useList);
+}
@@ -0,0 +1,20 @@
+/****************************************************/
+/* File: irgen.h                                    */
+/* TM code generation from the IR code for the      */
+/* TINY compiler                                    */
+/****************************************************/
+
+#ifndef _IRGEN_H_
+#define _IRGEN_H_
+
+/* Procedure irGen emits the TM code of the IR code
+ * of a unit (out of SSA form) through code.c: the
+ * body of a function, whose frame is set up by its
+ * caller, or the program, after the prelude of
+ * codeGen. It allocates registers to the values by
+ * linear scan; values live across a call are
+ * spilled to slots below the frame
+ */
+void irGen( void );
+
+#endif
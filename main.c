@@ -9,23 +9,26 @@
 
 /* if TRUE ---> scanner-only */
 #define NO_PARSE FALSE
-/* if TRUE ---> parser-only */
+/* if TRUE ---> parser-only, unless an option
+   asks for code (-b, -O, -S or -r) */
 #define NO_ANALYZE TRUE
 
-/* if TRUE ---> don't generate code */
+/* if TRUE ---> don't generate code, unless an
+   option asks for it */
 #define NO_CODE TRUE
 
 #include "util.h"
+#include "arena.h"
+#include "intern.h"
+#include "symtab.h"
 #if NO_PARSE
 #include "scan.h"
 #else
 #include "parse.h"
-#if !NO_ANALYZE
 #include "analyze.h"
-#if !NO_CODE
+#include "fold.h"
 #include "cgen.h"
-#endif
-#endif
+#include "x86gen.h"
 #endif
 
 /* allocate global variables */
@@ -36,10 +39,19 @@ FILE * code;
 
 /* allocate and set tracing flags */
 int EchoSource = FALSE;
+int TokenStream = FALSE;
 int TraceScan = TRUE;
 int TraceParse = TRUE;
 int TraceAnalyze = FALSE;
 int TraceCode = FALSE;
+int TraceMemory = FALSE;
+int AnalyzeByFunction = FALSE;
+int BinaryCode = FALSE;
+int NativeCode = FALSE;
+int RunCode = FALSE;
+int Simplify = TRUE;
+int Peephole = TRUE;
+int OptLevel = 0;
 
 int Error = FALSE;
 
@@ -47,11 +59,45 @@ int main( int argc, char * argv[] )
 {
     TreeNode* syntaxTree;
     char pgm[120]; /* source code file name */
-    if (argc != 2) {
-        fprintf(stderr, "usage: %s <filename>\n", argv[0]);
+    int argi = 1;
+    /* TRUE if an option asks for code; then the
+       program is analyzed and code generated
+       whatever NO_ANALYZE and NO_CODE say */
+    int codeOption = FALSE;
+    /* -t parses from a token stream, -b writes
+       the TM code in binary, -O[level] optimizes
+       it (level 1 if not given), -S writes x86-64
+       assembly code instead, -r runs x86-64
+       machine code in memory */
+    while (argi < argc - 1 && argv[argi][0] == '-') {
+        char* opt = argv[argi++];
+        if (strcmp(opt, "-t") == 0)
+            TokenStream = TRUE;
+        else if (strcmp(opt, "-b") == 0)
+            BinaryCode = codeOption = TRUE;
+        else if (strcmp(opt, "-S") == 0)
+            NativeCode = codeOption = TRUE;
+        else if (strcmp(opt, "-r") == 0)
+            RunCode = codeOption = TRUE;
+        else if (opt[1] == 'O' && (opt[2] == '\0' ||
+                 (opt[2] >= '0' && opt[2] <= '2' && opt[3] == '\0'))) {
+            OptLevel = opt[2] ? opt[2] - '0' : 1;
+            codeOption = TRUE;
+        }
+        else {
+            argi = argc;
+            break;
+        }
+    }
+    if (argc != argi + 1) {
+        fprintf(stderr, "usage: %s [-t] [-b] [-O[level]] [-S] [-r] <filename>\n", argv[0]);
+        exit(1);
+    }
+    if (NO_PARSE && codeOption) {
+        fprintf(stderr, "%s: scanner-only build, no code can be generated\n", argv[0]);
         exit(1);
     }
-    strcpy(pgm, argv[1]);
+    strcpy(pgm, argv[argi]);
     if (strchr(pgm, '.') == NULL)
         strcat(pgm, ".tny");
     source = fopen(pgm, "r");
@@ -59,43 +105,56 @@ int main( int argc, char * argv[] )
         fprintf(stderr, "File %s not found\n", pgm);
         exit(1);
     }
-    listing = stdout; /* send listing to screen */
+    /* send listing to screen, apart from the output
+       of a program run */
+    listing = RunCode ? stderr : stdout;
     fprintf(listing, "\nTINY COMPILATION: %s\n", pgm);
 #if NO_PARSE
     while (getToken()!=ENDFILE);
 #else
+    if ((!NO_ANALYZE || codeOption) && AnalyzeByFunction) functionHook = analyzeFunction;
     syntaxTree = parse();
     if (TraceParse) {
         fprintf(listing,"\nSyntax tree:\n");
         printTree(syntaxTree);
     }
-#if !NO_ANALYZE
-  if (! Error)
-  { if (TraceAnalyze) fprintf(listing,"\nBuilding Symbol Table...\n");
-    buildSymtab(syntaxTree);
-    if (TraceAnalyze) fprintf(listing,"\nChecking Types...\n");
-    typeCheck(syntaxTree);
+  if ((!NO_ANALYZE || codeOption) && ! Error)
+  { if (TraceAnalyze) fprintf(listing,"\nBuilding Symbol Table and Checking Types...\n");
+    analyze(syntaxTree);
     if (TraceAnalyze) fprintf(listing,"\nType Checking Finished\n");
   }
-#if !NO_CODE
-  if (! Error)
+  if ((!(NO_ANALYZE || NO_CODE) || codeOption) && ! Error)
   { char * codefile;
     int fnlen = strcspn(pgm,".");
-    codefile = (char *) calloc(fnlen+4, sizeof(char));
-    strncpy(codefile,pgm,fnlen);
-    strcat(codefile,".tm");
-    code = fopen(codefile,"w");
-    if (code == NULL)
-    { printf("Unable to open %s\n",codefile);
-      exit(1);
+    if (Simplify) simplify(syntaxTree);
+    if (RunCode)
+    { /* no code file: the program runs in memory */
+      if (!x86Run(syntaxTree)) exit(1);
+    }
+    else
+    { codefile = (char *) calloc(fnlen+5, sizeof(char));
+      strncpy(codefile,pgm,fnlen);
+      strcat(codefile,NativeCode ? ".s" : BinaryCode ? ".tmb" : ".tm");
+      code = fopen(codefile,BinaryCode && !NativeCode ? "wb" : "w");
+      if (code == NULL)
+      { printf("Unable to open %s\n",codefile);
+        exit(1);
+      }
+      if (NativeCode) x86Gen(syntaxTree,codefile);
+      else codeGen(syntaxTree,codefile);
+      fclose(code);
     }
-    codeGen(syntaxTree,codefile);
-    fclose(code);
   }
 #endif
-#endif
-#endif
+  if (TraceMemory) printArenaStats(listing);
+  /* the syntax tree, its strings and the symbols go
+     with the arena; the next compilation unit would
+     start from here */
+  st_reset();
+  internReset();
+  arenaReset();
   fclose(source);
+  arenaFree();
   return 0;
 }
 
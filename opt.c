@@ -0,0 +1,1053 @@
+/****************************************************/
+/* File: opt.c                                      */
+/* Optimization passes over the IR code in SSA      */
+/* form for the TINY compiler: sparse conditional   */
+/* constant propagation, copy propagation, global   */
+/* value numbering over the dominator tree, loop    */
+/* invariant code motion, strength reduction of     */
+/* induction variables and dead code elimination    */
+/****************************************************/
+
+#include <limits.h>
+#include "globals.h"
+#include "ir.h"
+#include "opt.h"
+
+/* counts for the trace */
+static int folded, branches, blocks, copies, redundant, dead;
+static int hoisted, reduced;
+
+/* repl[v] is the value replacing v, or v */
+static int * repl = NULL;
+
+static int find( int v )
+{ int r = v;
+  while (repl[r] != r) r = repl[r];
+  while (repl[v] != r)
+  { int n = repl[v];
+    repl[v] = r;
+    v = n;
+  }
+  return r;
+}
+
+static void newRepl( void )
+{ int v;
+  repl = (int *) malloc((nValue+1)*sizeof(int));
+  if (repl == NULL) irNoMemory();
+  for (v=0;v<nValue;++v) repl[v] = v;
+}
+
+/* Procedure rewrite puts the replacements in
+ * the operands of all instructions
+ */
+static void rewrite( void )
+{ int b, i, k;
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+      { IrInstr * x = &irInstr[i];
+        if (x->op == IrPhi)
+          for (k=0;k<irBlock[b].npred;++k) x->args[k] = find(x->args[k]);
+        else
+        { if (x->a >= 0) x->a = find(x->a);
+          if (x->b >= 0) x->b = find(x->b);
+        }
+      }
+  free(repl);
+  repl = NULL;
+}
+
+/* Function fold computes a op b in *r as TM
+ * does; returns FALSE for a division that would
+ * stop the machine, which is left to it
+ */
+static int fold( IrOp op, int a, int b, int * r )
+{ unsigned ua = (unsigned) a, ub = (unsigned) b;
+  switch (op)
+  { case IrAdd: *r = (int) (ua+ub); return TRUE;
+    case IrSub: *r = (int) (ua-ub); return TRUE;
+    case IrMul: *r = (int) (ua*ub); return TRUE;
+    case IrDiv:
+      if (b == 0 || (a == INT_MIN && b == -1)) return FALSE;
+      *r = a/b;
+      return TRUE;
+    case IrLt:  *r = (int) (ua-ub) < 0; return TRUE; /* SUB, JLT */
+    case IrEq:  *r = a == b; return TRUE;
+    default:    return FALSE;
+  }
+}
+
+/********************************************/
+/* sparse conditional constant propagation  */
+/********************************************/
+
+/* the lattice of a value: no value seen yet,
+ * one constant, or more than one value
+ */
+#define TOP 0
+#define CONSTANT 1
+#define BOTTOM 2
+
+static int * lat, * cval;
+static char * blockExec, * edgeExec; /* edge k of b is 2*b+k */
+static int * flowWork, nflow;
+static int * ssaWork, nssa;
+static int * useStart, * useList;
+
+static void setValue( int v, int state, int c )
+{ if (lat[v] == BOTTOM) return;
+  if (state == CONSTANT && lat[v] == CONSTANT && cval[v] != c) state = BOTTOM;
+  if (state <= lat[v]) return;
+  lat[v] = state;
+  cval[v] = c;
+  ssaWork[nssa++] = v;
+}
+
+static void markEdge( int b, int k )
+{ if (edgeExec[2*b+k]) return;
+  edgeExec[2*b+k] = TRUE;
+  flowWork[nflow++] = 2*b+k;
+}
+
+/* Procedure visit evaluates instruction i over
+ * the lattice
+ */
+static void visit( int i )
+{ IrInstr * x = &irInstr[i];
+  int b = x->block, k, state, c, r;
+  switch (x->op)
+  { case IrConst:
+      setValue(x->dst, CONSTANT, x->val);
+      break;
+    case IrCopy:
+      setValue(x->dst, lat[x->a], cval[x->a]);
+      break;
+    case IrAdd: case IrSub: case IrMul: case IrDiv:
+    case IrLt: case IrEq:
+      /* float operations (which irLower does not
+         produce yet) are left alone */
+      if (irValue[x->a].type == Float || irValue[x->b].type == Float)
+        setValue(x->dst, BOTTOM, 0);
+      else if (lat[x->a] == TOP || lat[x->b] == TOP) break;
+      else if (lat[x->a] == CONSTANT && lat[x->b] == CONSTANT
+               && fold(x->op, cval[x->a], cval[x->b], &r))
+        setValue(x->dst, CONSTANT, r);
+      else setValue(x->dst, BOTTOM, 0);
+      break;
+    case IrRead: case IrLoad: case IrCall:
+      setValue(x->dst, BOTTOM, 0);
+      break;
+    case IrPhi:
+      state = TOP;
+      c = 0;
+      for (k=0;k<irBlock[b].npred && state!=BOTTOM;++k)
+      { int p = irBlock[b].pred[k], v = x->args[k];
+        if (!edgeExec[2*p + (irBlock[p].succ[0] == b ? 0 : 1)]) continue;
+        if (lat[v] == BOTTOM) state = BOTTOM;
+        else if (lat[v] == CONSTANT)
+        { if (state == TOP) { state = CONSTANT; c = cval[v]; }
+          else if (c != cval[v]) state = BOTTOM;
+        }
+      }
+      setValue(x->dst, state, c);
+      break;
+    case IrJump:
+      markEdge(b, 0);
+      break;
+    case IrBranch:
+      if (lat[x->a] == CONSTANT) markEdge(b, cval[x->a] != 0 ? 0 : 1);
+      else if (lat[x->a] == BOTTOM)
+      { markEdge(b, 0);
+        markEdge(b, 1);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/* Procedure sccp propagates constants along the
+ * executable edges only (Wegman and Zadeck), then
+ * replaces constant values by IrConst, resolves
+ * constant branches and removes unreachable blocks
+ */
+static void sccp( void )
+{ int b, i, k;
+  lat = (int *) calloc(nValue+1, sizeof(int));
+  cval = (int *) calloc(nValue+1, sizeof(int));
+  blockExec = (char *) calloc(nBlock+1, sizeof(char));
+  edgeExec = (char *) calloc(2*nBlock+1, sizeof(char));
+  flowWork = (int *) malloc((2*nBlock+1)*sizeof(int));
+  ssaWork = (int *) malloc((2*nValue+1)*sizeof(int));
+  if (lat == NULL || cval == NULL || blockExec == NULL || edgeExec == NULL
+      || flowWork == NULL || ssaWork == NULL) irNoMemory();
+  irUses(&useStart, &useList);
+  nflow = nssa = 0;
+  blockExec[0] = TRUE;
+  for (i=irBlock[0].first;i>=0;i=irInstr[i].next) visit(i);
+  while (nflow > 0 || nssa > 0)
+  { while (nflow > 0)
+    { int e = flowWork[--nflow], s = irBlock[e/2].succ[e%2];
+      int first = !blockExec[s];
+      blockExec[s] = TRUE;
+      for (i=irBlock[s].first;i>=0;i=irInstr[i].next)
+        if (first || irInstr[i].op == IrPhi) visit(i);
+    }
+    while (nssa > 0)
+    { int v = ssaWork[--nssa];
+      for (k=useStart[v];k<useStart[v+1];++k)
+        if (blockExec[irInstr[useList[k]].block]) visit(useList[k]);
+    }
+  }
+  for (b=0;b<nBlock;++b)
+  { IrBlock * t = &irBlock[b];
+    if (t->dead) continue;
+    if (!blockExec[b])
+    { t->dead = TRUE;
+      if (t->succ[0] >= 0) irRemovePred(t->succ[0], b);
+      if (t->succ[1] >= 0) irRemovePred(t->succ[1], b);
+      blocks++;
+      continue;
+    }
+    for (i=t->first;i>=0;i=irInstr[i].next)
+    { IrInstr * x = &irInstr[i];
+      if (x->dst >= 0 && x->op != IrConst && lat[x->dst] == CONSTANT)
+      { x->op = IrConst;
+        x->val = cval[x->dst];
+        x->a = x->b = -1;
+        folded++;
+      }
+      else if (x->op == IrBranch && lat[x->a] == CONSTANT)
+      { k = cval[x->a] != 0 ? 0 : 1;
+        irRemovePred(t->succ[1-k], b);
+        t->succ[0] = t->succ[k];
+        t->succ[1] = -1;
+        x->op = IrJump;
+        x->a = -1;
+        branches++;
+      }
+    }
+  }
+  free(lat); free(cval); free(blockExec); free(edgeExec);
+  free(flowWork); free(ssaWork); free(useStart); free(useList);
+}
+
+/********************************************/
+/* copy propagation                         */
+/********************************************/
+
+/* Procedure copyProp replaces the destination of
+ * each copy by its source, and each phi whose
+ * arguments are one value (or the phi itself) by
+ * that value
+ */
+static void copyProp( void )
+{ int b, i, k, changed;
+  newRepl();
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+        if (irInstr[i].op == IrCopy)
+        { repl[irInstr[i].dst] = find(irInstr[i].a);
+          irInstr[i].op = IrNop;
+          copies++;
+        }
+  do
+  { changed = FALSE;
+    for (b=0;b<nBlock;++b)
+      if (!irBlock[b].dead)
+        for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+        { IrInstr * x = &irInstr[i];
+          int same = -1;
+          if (x->op != IrPhi) continue;
+          for (k=0;k<irBlock[b].npred;++k)
+          { int v = find(x->args[k]);
+            if (v == x->dst || v == same) continue;
+            if (same >= 0) break;
+            same = v;
+          }
+          if (k == irBlock[b].npred && same >= 0)
+          { repl[x->dst] = same;
+            x->op = IrNop;
+            copies++;
+            changed = TRUE;
+          }
+        }
+  } while (changed);
+  rewrite();
+  irSweep();
+}
+
+/********************************************/
+/* global value numbering                   */
+/********************************************/
+
+/* the available expressions: a hash table whose
+ * entries are pushed on a stack, so that those of
+ * a block are dropped when the walk of the
+ * dominator tree leaves it
+ */
+typedef struct
+   { IrOp op;
+     int a, b;
+     int value;
+     int next; /* in the bucket */
+   } Avail;
+
+static Avail * avail = NULL;
+static int navail = 0, maxavail = 0;
+static int * bucket = NULL;
+static unsigned hashMask;
+
+#define hashExp(op,a,b) \
+  ((((unsigned)(op)*31u + (unsigned)(a))*2654435769u + (unsigned)(b)) & hashMask)
+
+/* Procedure number numbers the instructions of
+ * block b: one computing what a dominating one
+ * computed already is removed
+ */
+static void number( int b )
+{ int i, k;
+  for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+  { IrInstr * x = &irInstr[i];
+    unsigned h;
+    int e, t;
+    if (x->op == IrPhi)
+    { int same = -1;
+      for (k=0;k<irBlock[b].npred;++k)
+      { int v = find(x->args[k]);
+        if (v == same) continue;
+        if (same >= 0) break;
+        same = v;
+      }
+      if (k == irBlock[b].npred && same >= 0)
+      { repl[x->dst] = same;
+        x->op = IrNop;
+        redundant++;
+      }
+      continue;
+    }
+    /* constants are cheaper to load again than to
+       keep in one of the few TM registers */
+    if (x->op < IrAdd || x->op > IrEq) continue;
+    x->a = find(x->a);
+    x->b = find(x->b);
+    if ((x->op == IrAdd || x->op == IrMul || x->op == IrEq) && x->a > x->b)
+    { t = x->a; x->a = x->b; x->b = t;
+    }
+    h = hashExp(x->op, x->a, x->b);
+    for (e=bucket[h];e>=0;e=avail[e].next)
+      if (avail[e].op == x->op && avail[e].a == x->a && avail[e].b == x->b)
+        break;
+    if (e >= 0)
+    { repl[x->dst] = avail[e].value;
+      x->op = IrNop;
+      redundant++;
+      continue;
+    }
+    if (navail == maxavail)
+    { maxavail = maxavail ? 2*maxavail : 256;
+      avail = (Avail *) realloc(avail, maxavail*sizeof(Avail));
+      if (avail == NULL) irNoMemory();
+    }
+    avail[navail].op = x->op;
+    avail[navail].a = x->a;
+    avail[navail].b = x->b;
+    avail[navail].value = x->dst;
+    avail[navail].next = bucket[h];
+    bucket[h] = navail++;
+  }
+}
+
+static void gvn( void )
+{ int * stack, * mark, top = 0;
+  unsigned size = 256;
+  while (size < (unsigned) nInstr) size *= 2;
+  hashMask = size-1;
+  bucket = (int *) malloc(size*sizeof(int));
+  stack = (int *) malloc((nBlock+1)*sizeof(int));
+  mark = (int *) malloc((nBlock+1)*sizeof(int));
+  if (bucket == NULL || stack == NULL || mark == NULL) irNoMemory();
+  memset(bucket, -1, size*sizeof(int));
+  newRepl();
+  irDominators();
+  navail = 0;
+  stack[top++] = 0;
+  mark[0] = 0;
+  number(0);
+  while (top > 0)
+  { int b = stack[top-1], c = irBlock[b].domChild;
+    if (c >= 0)
+    { irBlock[b].domChild = irBlock[c].domSibling;
+      mark[c] = navail;
+      number(c);
+      stack[top++] = c;
+    }
+    else
+    { /* drop the entries of b, newest first */
+      while (navail > mark[b])
+      { Avail * e = &avail[--navail];
+        bucket[hashExp(e->op, e->a, e->b)] = e->next;
+      }
+      top--;
+    }
+  }
+  free(stack); free(mark); free(bucket);
+  free(avail);
+  avail = NULL;
+  maxavail = 0;
+  rewrite();
+  irSweep();
+  irDominators();
+}
+
+/********************************************/
+/* dead code elimination                    */
+/********************************************/
+
+/* Function critical is TRUE for an instruction
+ * that must stay: one with an effect, or a
+ * division or a load of an array element (whose
+ * index is not checked) that may stop the machine
+ */
+static int critical( IrInstr * x )
+{ int d;
+  switch (x->op)
+  { case IrRead: case IrWrite: case IrJump: case IrBranch: case IrHalt:
+    case IrStore: case IrArg: case IrCall: case IrRet:
+      return TRUE;
+    case IrLoad:
+      return x->a >= 0;
+    case IrDiv:
+      d = irValue[x->b].def;
+      return d < 0 || irInstr[d].op != IrConst
+             || irInstr[d].val == 0 || irInstr[d].val == -1;
+    default:
+      return FALSE;
+  }
+}
+
+/* Procedure dce removes the instructions no
+ * critical instruction depends on
+ */
+static void dce( void )
+{ char * live = (char *) calloc(nInstr+1, sizeof(char));
+  int * work = (int *) malloc((nInstr+1)*sizeof(int));
+  int n = 0, b, i, k;
+  if (live == NULL || work == NULL) irNoMemory();
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+        if (critical(&irInstr[i]))
+        { live[i] = TRUE;
+          work[n++] = i;
+        }
+  while (n > 0)
+  { IrInstr * x = &irInstr[work[--n]];
+    int np = (x->op == IrPhi) ? irBlock[x->block].npred : 2;
+    for (k=0;k<np;++k)
+    { int v = (x->op == IrPhi) ? x->args[k] : (k == 0 ? x->a : x->b);
+      int d = (v >= 0) ? irValue[v].def : -1;
+      if (d >= 0 && !live[d])
+      { live[d] = TRUE;
+        work[n++] = d;
+      }
+    }
+  }
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+        if (!live[i])
+        { irInstr[i].op = IrNop;
+          dead++;
+        }
+  free(live);
+  free(work);
+  irSweep();
+}
+
+/********************************************/
+/* loop optimizations                       */
+/********************************************/
+
+/* A natural loop: its header, the blocks of its
+ * body (the header first, then in reverse
+ * postorder), the one block entering it, which
+ * goes nowhere else, its latch if it has only
+ * one, and the innermost loop around it; -1 for
+ * those missing
+ */
+typedef struct
+   { int header;
+     int * blocks, nblocks;
+     int preheader;
+     int latch;
+     int parent;
+   } Loop;
+
+/* inLoop[b] is stamp if block b is in the body
+ * of the loop being optimized; loopOf[b] is the
+ * innermost loop whose body holds block b, or -1
+ */
+static int * inLoop;
+static int stamp;
+static int * loopOf;
+
+/* rpo[b] is the place of block b in irOrder */
+static int * rpo;
+
+/* Function dominates is TRUE if block a
+ * dominates block b
+ */
+static int dominates( int a, int b )
+{ while (b != a)
+  { if (b == 0) return FALSE;
+    b = irBlock[b].idom;
+  }
+  return TRUE;
+}
+
+static int compareRpo( const void * a, const void * b )
+{ return rpo[*(const int *) a] - rpo[*(const int *) b];
+}
+
+static int compareLoops( const void * a, const void * b )
+{ return ((const Loop *) a)->nblocks - ((const Loop *) b)->nblocks;
+}
+
+/* Function findLoops returns the natural loops,
+ * inner ones (which are smaller) first, and sets
+ * *n to their number; it fills loopOf. A back
+ * edge goes to a block dominating its source,
+ * which never comes later in reverse postorder
+ */
+static Loop * findLoops( int * n )
+{ Loop * list = NULL;
+  int * work = (int *) malloc((nBlock+1)*sizeof(int));
+  int * body = (int *) malloc((nBlock+1)*sizeof(int));
+  int nloops = 0, maxloops = 0, k, j, h;
+  if (work == NULL || body == NULL) irNoMemory();
+  for (k=0;k<nOrder;++k) rpo[irOrder[k]] = k;
+  for (k=0;k<nOrder;++k)
+  { Loop * l;
+    int nwork = 0, nlatch = 0, latch = -1, entry = -1, nentry = 0;
+    h = irOrder[k];
+    stamp++;
+    for (j=0;j<irBlock[h].npred;++j)
+    { int p = irBlock[h].pred[j];
+      if (rpo[p] < k || !dominates(h,p)) continue;
+      latch = p;
+      nlatch++;
+      if (inLoop[p] != stamp && p != h)
+      { inLoop[p] = stamp;
+        work[nwork++] = p;
+      }
+    }
+    if (nlatch == 0) continue;
+    if (nloops == maxloops)
+    { maxloops = maxloops ? 2*maxloops : 16;
+      list = (Loop *) realloc(list, maxloops*sizeof(Loop));
+      if (list == NULL) irNoMemory();
+    }
+    l = &list[nloops++];
+    l->header = h;
+    l->latch = (nlatch == 1) ? latch : -1;
+    inLoop[h] = stamp;
+    body[0] = h;
+    l->nblocks = 1;
+    while (nwork > 0)
+    { int b = work[--nwork];
+      body[l->nblocks++] = b;
+      for (j=0;j<irBlock[b].npred;++j)
+      { int p = irBlock[b].pred[j];
+        if (inLoop[p] != stamp)
+        { inLoop[p] = stamp;
+          work[nwork++] = p;
+        }
+      }
+    }
+    /* the header comes first in reverse postorder */
+    qsort(body, l->nblocks, sizeof(int), compareRpo);
+    l->blocks = (int *) malloc(l->nblocks*sizeof(int));
+    if (l->blocks == NULL) irNoMemory();
+    memcpy(l->blocks, body, l->nblocks*sizeof(int));
+    for (j=0;j<irBlock[h].npred;++j)
+      if (inLoop[irBlock[h].pred[j]] != stamp)
+      { entry = irBlock[h].pred[j];
+        nentry++;
+      }
+    l->preheader = (nentry == 1 && irBlock[entry].succ[1] < 0) ? entry : -1;
+  }
+  qsort(list, nloops, sizeof(Loop), compareLoops);
+  /* outer loops first, so that each block ends up
+     with the innermost loop holding it */
+  for (k=0;k<nBlock;++k) loopOf[k] = -1;
+  for (k=nloops-1;k>=0;--k)
+  { list[k].parent = loopOf[list[k].header];
+    for (j=0;j<list[k].nblocks;++j) loopOf[list[k].blocks[j]] = k;
+  }
+  free(work);
+  free(body);
+  *n = nloops;
+  return list;
+}
+
+/* Function constDef returns the IrConst defining
+ * value v, or -1
+ */
+static int constDef( int v )
+{ int d = irValue[v].def;
+  return (d >= 0 && irInstr[d].op == IrConst) ? d : -1;
+}
+
+/* Function inBody is TRUE if value v is defined
+ * in the body of the loop stamped in inLoop
+ */
+static int inBody( int v )
+{ int d = irValue[v].def;
+  return d >= 0 && inLoop[irInstr[d].block] == stamp;
+}
+
+/* Function definedIn is TRUE if value v is
+ * defined in the body of loop t of list
+ */
+static int definedIn( int v, Loop * list, int t )
+{ int d = irValue[v].def, j;
+  if (d < 0) return FALSE;
+  for (j=loopOf[irInstr[d].block];j>=0;j=list[j].parent)
+    if (j == t) return TRUE;
+  return FALSE;
+}
+
+/* Function invariant is TRUE if value v does not
+ * change in loop t of list: it is defined outside
+ * the body or is a constant
+ */
+static int invariant( int v, Loop * list, int t )
+{ return constDef(v) >= 0 || !definedIn(v, list, t);
+}
+
+/* Function newConst returns a new value holding
+ * constant c, defined at the end of block b
+ */
+static int newConst( int c, int b )
+{ int v = newValue(Integer, 0);
+  int i = newInstr(IrConst, v, -1, -1);
+  irInstr[i].val = c;
+  irInsertCopies(b, i);
+  return v;
+}
+
+/* Procedure hoist moves the computations of loop
+ * k of list whose operands are invariant in it to
+ * the preheader of the outermost loop around it
+ * (with a preheader) in which they are invariant,
+ * so that they are done once, not once for each
+ * time an inner loop is entered. They do not stop
+ * the machine, so doing them when the loop is not
+ * entered is harmless. Constants defined inside
+ * that loop are copied along; they stay where they
+ * are too, as they are loaded where they are used
+ */
+static void hoist( Loop * list, int k )
+{ Loop * l = &list[k];
+  int j, i, prev, next;
+  for (j=0;j<l->nblocks;++j)
+  { IrBlock * t = &irBlock[l->blocks[j]];
+    for (prev=-1,i=t->first;i>=0;i=next)
+    { IrInstr * x = &irInstr[i];
+      int to = k, o, pre, v;
+      next = x->next;
+      if (x->op < IrAdd || x->op > IrEq || (x->op == IrDiv && critical(x))
+          || !invariant(x->a, list, k) || !invariant(x->b, list, k))
+      { prev = i;
+        continue;
+      }
+      for (o=l->parent;o>=0;o=list[o].parent)
+      { if (!invariant(x->a, list, o) || !invariant(x->b, list, o)) break;
+        if (list[o].preheader >= 0) to = o;
+      }
+      pre = list[to].preheader;
+      if (constDef(x->a) >= 0 && definedIn(x->a, list, to))
+      { v = newConst(irInstr[constDef(x->a)].val, pre);
+        irInstr[i].a = v;
+      }
+      if (constDef(x->b) >= 0 && definedIn(x->b, list, to))
+      { v = newConst(irInstr[constDef(x->b)].val, pre);
+        irInstr[i].b = v;
+      }
+      /* unlink it (a jump ends the block, so it is
+         not the last) and put it in the preheader */
+      if (prev < 0) t->first = next;
+      else irInstr[prev].next = next;
+      irInstr[i].next = -1;
+      irInsertCopies(pre, i);
+      hoisted++;
+    }
+  }
+}
+
+/* The induction values of the loop being reduced:
+ * value v is mul[v]*i+add[v] for the basic
+ * induction variable i (a header phi stepped by a
+ * constant in each iteration) if iv[v] = i, where
+ * step[i] is its step; and cost[v] counts the
+ * operations computing v from i. They are set for
+ * the values defined in the body, the others have
+ * none. A value v to be replaced has gain[v] >= 0,
+ * and dies[v] is TRUE if it is left unused then
+ */
+static int * iv, * cost, * step, * gain, * dies;
+static unsigned * mul, * add;
+static int maxiv = 0;
+
+static int ivOf( int v )
+{ return inBody(v) ? iv[v] : -1;
+}
+
+/* the induction variables made by reduce, as
+ * value newIV[k] = newMul[k]*newBase[k]+newAdd[k]
+ */
+static int * newIV, * newBase;
+static unsigned * newMul, * newAdd;
+static int nnew, maxnew = 0;
+
+/* Procedure affine sets the induction value of
+ * the value defined by x, if x adds, subtracts or
+ * multiplies an induction value and a constant
+ */
+static void affine( IrInstr * x )
+{ int v = x->dst, f, c, left;
+  unsigned k;
+  iv[v] = -1;
+  if (x->op != IrAdd && x->op != IrSub && x->op != IrMul) return;
+  left = ivOf(x->a) >= 0 && constDef(x->b) >= 0;
+  if (left) { f = x->a; c = constDef(x->b); }
+  else if (ivOf(x->b) >= 0 && constDef(x->a) >= 0)
+  { f = x->b; c = constDef(x->a); }
+  else return;
+  k = (unsigned) irInstr[c].val;
+  iv[v] = iv[f];
+  cost[v] = cost[f]+1;
+  switch (x->op)
+  { case IrAdd:
+      mul[v] = mul[f];
+      add[v] = add[f]+k;
+      break;
+    case IrSub:
+      mul[v] = left ? mul[f] : -mul[f];
+      add[v] = left ? add[f]-k : k-add[f];
+      break;
+    default:
+      mul[v] = mul[f]*k;
+      add[v] = add[f]*k;
+      break;
+  }
+}
+
+/* Function makeIV returns an induction variable
+ * holding m*i+c for basic induction variable i of
+ * loop l: a phi in the header, started in the
+ * preheader and stepped at the end of the latch
+ */
+static int makeIV( Loop * l, int i, unsigned m, unsigned c )
+{ int h = l->header, pre = irPredIndex(h, l->preheader);
+  int k, p, v, init, t;
+  for (k=0;k<nnew;++k)
+    if (newBase[k] == i && newMul[k] == m && newAdd[k] == c) return newIV[k];
+  /* its initial value, from that of i */
+  init = irInstr[irValue[i].def].args[pre];
+  if (constDef(init) >= 0)
+    init = newConst((int) (m*(unsigned) irInstr[constDef(init)].val+c),
+                    l->preheader);
+  else
+  { if (m != 1)
+    { t = newValue(Integer, 0);
+      k = newConst((int) m, l->preheader);
+      irInsertCopies(l->preheader, newInstr(IrMul, t, init, k));
+      init = t;
+    }
+    if (c != 0)
+    { t = newValue(Integer, 0);
+      k = newConst((int) c, l->preheader);
+      irInsertCopies(l->preheader, newInstr(IrAdd, t, init, k));
+      init = t;
+    }
+  }
+  v = newValue(Integer, 0);
+  p = newInstr(IrPhi, v, -1, -1);
+  irInstr[p].val = -1;
+  irInstr[p].args = (int *) malloc((irBlock[h].npred+1)*sizeof(int));
+  if (irInstr[p].args == NULL) irNoMemory();
+  irPrepend(h, p);
+  t = newValue(Integer, 0);
+  k = newConst((int) (m*(unsigned) step[i]), l->latch);
+  irInsertCopies(l->latch, newInstr(IrAdd, t, v, k));
+  for (k=0;k<irBlock[h].npred;++k)
+    irInstr[p].args[k] = (k == pre) ? init : t;
+  if (nnew == maxnew)
+  { maxnew = maxnew ? 2*maxnew : 16;
+    newIV = (int *) realloc(newIV, maxnew*sizeof(int));
+    newBase = (int *) realloc(newBase, maxnew*sizeof(int));
+    newMul = (unsigned *) realloc(newMul, maxnew*sizeof(unsigned));
+    newAdd = (unsigned *) realloc(newAdd, maxnew*sizeof(unsigned));
+    if (newIV == NULL || newBase == NULL || newMul == NULL || newAdd == NULL)
+      irNoMemory();
+  }
+  newIV[nnew] = v;
+  newBase[nnew] = i;
+  newMul[nnew] = m;
+  newAdd[nnew++] = c;
+  return v;
+}
+
+/* Procedure replace makes the instructions using
+ * value v use value r instead; useStart and
+ * useList hold the uses of the first n values
+ */
+static int nUses;
+
+static void replace( int v, int r )
+{ int j, k;
+  for (j=useStart[v];j<useStart[v+1];++j)
+  { IrInstr * x = &irInstr[useList[j]];
+    if (x->op == IrPhi)
+    { for (k=0;k<irBlock[x->block].npred;++k)
+        if (x->args[k] == v) x->args[k] = r;
+    }
+    else
+    { if (x->a == v) x->a = r;
+      if (x->b == v) x->b = r;
+    }
+  }
+}
+
+/* Function chain returns the number of operations
+ * done each time round the loop that replacing
+ * induction value v by a variable of its own
+ * saves, less the one stepping it: v and those it
+ * alone uses, back to the basic variable. It marks
+ * them in dies
+ */
+static int chain( int v )
+{ int d = 0, f;
+  for (f=v;;)
+  { IrInstr * x = &irInstr[irValue[f].def];
+    dies[f] = TRUE;
+    d++;
+    f = (ivOf(x->a) >= 0 && constDef(x->b) >= 0) ? x->a : x->b;
+    if (iv[f] == f || f >= nUses || useStart[f+1]-useStart[f] != 1) break;
+  }
+  return d-1;
+}
+
+/* Function setup returns the TM instructions that
+ * starting the variable replacing v in the
+ * preheader of loop l takes each time the loop is
+ * entered, counting the copy into it, or 0 for an
+ * outermost loop, which is entered once. Each
+ * operation with a constant takes a load of the
+ * constant too, so an operation saved in each
+ * iteration is two instructions
+ */
+static int setup( Loop * l, int v )
+{ int init;
+  if (l->parent < 0) return 0;
+  init = irInstr[irValue[iv[v]].def].args[irPredIndex(l->header, l->preheader)];
+  if (constDef(init) >= 0) return 2;
+  return 2*((mul[v] != 1)+(add[v] != 0))+1;
+}
+
+/* Function gone is TRUE if instruction x, which
+ * uses a basic induction variable or its step,
+ * is left unused once the values marked in dies
+ * are, or computes value v
+ */
+static int gone( IrInstr * x, int v )
+{ int d = x->dst;
+  if (d < 0 || d >= nUses) return FALSE;
+  if (d == v || useStart[d] == useStart[d+1]) return TRUE;
+  return inLoop[x->block] == stamp && x->op != IrPhi && dies[d];
+}
+
+/* Function unused is TRUE if basic induction
+ * variable i of the loop is left unused once the
+ * values marked in dies are: it only steps
+ * itself then. Its step s is at index lat
+ */
+static int unused( int i, int lat )
+{ int s = irInstr[irValue[i].def].args[lat], j;
+  if (i >= nUses || s >= nUses) return FALSE;
+  for (j=useStart[i];j<useStart[i+1];++j)
+    if (!gone(&irInstr[useList[j]], s)) return FALSE;
+  for (j=useStart[s];j<useStart[s+1];++j)
+    if (!gone(&irInstr[useList[j]], i)) return FALSE;
+  return TRUE;
+}
+
+/* Procedure reduce strength-reduces the induction
+ * values of loop l (with one latch): one computed
+ * by more than one operation and used other than
+ * to compute induction values is replaced by an
+ * induction variable of its own, stepped by an
+ * addition, when that saves two operations or
+ * more in each iteration, and enough to pay for
+ * its setup: TM multiplies as fast as it adds,
+ * and the new variable takes one of its few
+ * registers, which a single operation saved does
+ * not pay for. But the values of a basic variable
+ * are all replaced if it is left unused then, as
+ * its step is saved too. The operations left
+ * unused are removed by dce
+ */
+static void reduce( Loop * l )
+{ int h = l->header, lat = irPredIndex(h, l->latch);
+  int k, i, j, p, n = nValue;
+  if (nValue >= maxiv)
+  { maxiv = 2*nValue+16;
+    iv = (int *) realloc(iv, maxiv*sizeof(int));
+    cost = (int *) realloc(cost, maxiv*sizeof(int));
+    step = (int *) realloc(step, maxiv*sizeof(int));
+    mul = (unsigned *) realloc(mul, maxiv*sizeof(unsigned));
+    add = (unsigned *) realloc(add, maxiv*sizeof(unsigned));
+    gain = (int *) realloc(gain, maxiv*sizeof(int));
+    dies = (int *) realloc(dies, maxiv*sizeof(int));
+    if (iv == NULL || cost == NULL || step == NULL || mul == NULL || add == NULL
+        || gain == NULL || dies == NULL)
+      irNoMemory();
+  }
+  /* the phis (sccp may have made constants of
+     some), and among them the basic induction
+     variables of the header */
+  for (k=0;k<l->nblocks;++k)
+    for (i=irBlock[l->blocks[k]].first;i>=0;i=irInstr[i].next)
+      if (irInstr[i].op == IrPhi) iv[irInstr[i].dst] = -1;
+  for (i=irBlock[h].first;i>=0;i=irInstr[i].next)
+  { int p = irInstr[i].dst, s;
+    IrInstr * x;
+    if (irInstr[i].op != IrPhi) continue;
+    s = irInstr[i].args[lat];
+    if (!inBody(s)) continue;
+    x = &irInstr[irValue[s].def];
+    if (x->op == IrAdd && x->a == p && constDef(x->b) >= 0)
+      step[p] = irInstr[constDef(x->b)].val;
+    else if (x->op == IrAdd && x->b == p && constDef(x->a) >= 0)
+      step[p] = irInstr[constDef(x->a)].val;
+    else if (x->op == IrSub && x->a == p && constDef(x->b) >= 0)
+      step[p] = (int) -(unsigned) irInstr[constDef(x->b)].val;
+    else continue;
+    iv[p] = p;
+    mul[p] = 1;
+    add[p] = 0;
+    cost[p] = 0;
+  }
+  /* the induction values derived from them */
+  for (k=0;k<l->nblocks;++k)
+    for (i=irBlock[l->blocks[k]].first;i>=0;i=irInstr[i].next)
+      if (irInstr[i].dst >= 0 && irInstr[i].op != IrPhi)
+        affine(&irInstr[i]);
+  /* the values to replace */
+  for (k=0;k<l->nblocks;++k)
+    for (i=irBlock[l->blocks[k]].first;i>=0;i=irInstr[i].next)
+      if (irInstr[i].dst >= 0)
+      { gain[irInstr[i].dst] = -1;
+        dies[irInstr[i].dst] = FALSE;
+      }
+  for (k=0;k<l->nblocks;++k)
+    for (i=irBlock[l->blocks[k]].first;i>=0;i=irInstr[i].next)
+    { int v = irInstr[i].dst, other = FALSE;
+      if (v < 0 || v >= n || v >= nUses || irInstr[i].op == IrPhi
+          || iv[v] < 0 || cost[v] < 2)
+        continue;
+      for (j=useStart[v];j<useStart[v+1];++j)
+      { IrInstr * u = &irInstr[useList[j]];
+        if (u->op == IrPhi || u->dst < 0 || u->dst >= n || ivOf(u->dst) < 0)
+          other = TRUE;
+      }
+      if (other) gain[v] = chain(v);
+    }
+  /* those that pay, for each basic variable */
+  nnew = 0;
+  for (p=irBlock[h].first;p>=0;p=irInstr[p].next)
+  { int b = irInstr[p].dst, all, total = 0, cost0 = 0;
+    if (irInstr[p].op != IrPhi || iv[b] != b) continue;
+    for (k=0;k<l->nblocks;++k)
+      for (i=irBlock[l->blocks[k]].first;i>=0;i=irInstr[i].next)
+      { int v = irInstr[i].dst;
+        if (v < 0 || v >= n || gain[v] < 0 || iv[v] != b) continue;
+        total += 2*gain[v];
+        cost0 += setup(l, v);
+      }
+    all = unused(b, lat) && 2*(total+1) >= cost0;
+    for (k=0;k<l->nblocks;++k)
+      for (i=irBlock[l->blocks[k]].first;i>=0;i=irInstr[i].next)
+      { int v = irInstr[i].dst;
+        if (v < 0 || v >= n || gain[v] < 0 || iv[v] != b) continue;
+        if (!all && (gain[v] < 2 || 2*gain[v] < setup(l, v))) continue;
+        replace(v, makeIV(l, b, mul[v], add[v]));
+        reduced++;
+      }
+  }
+}
+
+/* Procedure loops optimizes the loops, inner ones
+ * first, so that what is moved out of a loop may
+ * move out of the one around it too, as what
+ * makeIV puts in a preheader
+ */
+static void loops( void )
+{ Loop * l;
+  int n, k, j;
+  inLoop = (int *) calloc(nBlock+1, sizeof(int));
+  loopOf = (int *) malloc((nBlock+1)*sizeof(int));
+  rpo = (int *) malloc((nBlock+1)*sizeof(int));
+  if (inLoop == NULL || loopOf == NULL || rpo == NULL) irNoMemory();
+  stamp = 0;
+  l = findLoops(&n);
+  irUses(&useStart, &useList);
+  nUses = nValue;
+  for (k=0;k<n;++k)
+  { if (l[k].preheader < 0) continue;
+    stamp++;
+    for (j=0;j<l[k].nblocks;++j) inLoop[l[k].blocks[j]] = stamp;
+    hoist(l, k);
+    if (l[k].latch >= 0) reduce(&l[k]);
+  }
+  for (k=0;k<n;++k) free(l[k].blocks);
+  free(l);
+  free(inLoop); free(loopOf); free(rpo);
+  free(useStart); free(useList);
+  free(iv); free(cost); free(step); free(mul); free(add);
+  free(gain); free(dies);
+  iv = cost = step = gain = dies = NULL;
+  mul = add = NULL;
+  maxiv = 0;
+  free(newIV); free(newBase); free(newMul); free(newAdd);
+  newIV = newBase = NULL;
+  newMul = newAdd = NULL;
+  maxnew = 0;
+}
+
+void optimize( int level )
+{ int before = irCount();
+  folded = branches = blocks = copies = redundant = dead = 0;
+  hoisted = reduced = 0;
+  sccp();
+  copyProp();
+  if (level >= 2)
+  { gvn();
+    loops();
+  }
+  dce();
+  if (TraceCode)
+  { fprintf(listing,"IR optimization (-O%d) removed %d of %d instructions:\n",
+            level,before-irCount(),before);
+    fprintf(listing,"  %d folded, %d branches and %d blocks removed, "
+            "%d copies, %d redundant, %d dead\n",
+            folded,branches,blocks,copies,redundant,dead);
+    if (level >= 2)
+      fprintf(listing,"  %d moved out of loops, %d induction values reduced\n",
+              hoisted,reduced);
+  }
+}
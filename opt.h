@@ -0,0 +1,20 @@
+/****************************************************/
+/* File: opt.h                                      */
+/* Optimization passes over the IR code in SSA      */
+/* form for the TINY compiler                       */
+/****************************************************/
+
+#ifndef _OPT_H_
+#define _OPT_H_
+
+/* Procedure optimize runs the passes of level
+ * (the -O option) over the IR code in SSA form:
+ * level 1 propagates constants and copies and
+ * removes dead code, level 2 also numbers values
+ * globally to remove redundant computations, moves
+ * loop-invariant computations out of loops and
+ * strength-reduces induction variables
+ */
+void optimize( int level );
+
+#endif
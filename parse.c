@@ -8,10 +8,17 @@
 #include "globals.h"
 #include "util.h"
 #include "scan.h"
+#include "intern.h"
 #include "parse.h"
 
 static TokenType token; /* holds current token */
 
+/* index of the current token in the token stream */
+static int tokenPos = -1;
+
+/* called with each function once it is parsed */
+void (*functionHook)(TreeNode*) = NULL;
+
 /* function prototypes for recursive calls */
 static TreeNode* func_sequence(void);
 static TreeNode* function(void);
@@ -33,6 +40,49 @@ static TreeNode* term(void);
 static TreeNode* factor(void);
 static TreeNode* params(void);
 
+/* nextToken moves to the next token, taken from the
+ * token stream if TokenStream is set
+ */
+static void nextToken(void)
+{
+    if (TokenStream)
+    {
+        if (tokenPos < tokenCount - 1) tokenPos++;
+        token = tokenStream[tokenPos].type;
+        lineno = tokenStream[tokenPos].lineno;
+    }
+    else token = getToken();
+}
+
+/* currentText returns the lexeme of the current
+ * token as a string (in tokenString)
+ */
+static char* currentText(void)
+{
+    if (TokenStream)
+    {
+        const TokenRec* r = &tokenStream[tokenPos];
+        memcpy(tokenString, tokenText(r), r->length);
+        tokenString[r->length] = '\0';
+    }
+    return tokenString;
+}
+
+/* setName gives tree node t the name of the current
+ * ID token: its atom and the interned string; from
+ * the token stream the lexeme is interned in place
+ */
+static void setName(TreeNode* t)
+{
+    if (TokenStream)
+    {
+        const TokenRec* r = &tokenStream[tokenPos];
+        t->attr.atom = internName(tokenText(r), r->length);
+    }
+    else t->attr.atom = internName(tokenString, (int)strlen(tokenString));
+    t->attr.name = atomName(t->attr.atom);
+}
+
 static void syntaxError(char* message)
 {
     fprintf(listing, "\n>>> Syntax error at line %d: %s", lineno, message);
@@ -41,17 +91,17 @@ static void syntaxError(char* message)
 
 static void match(TokenType expected)
 {
-    if (token == expected) token = getToken();
+    if (token == expected) nextToken();
     else {
         syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
+        printToken(token, currentText());
         fprintf(listing, "      ");
     }
 }
 
 static void getType(TreeNode* t)
 {
-    switch (tokenString[0])
+    switch (currentText()[0])
     {
     case 'v': t->type = Void; break;
     case 'i': t->type = Integer; break;
@@ -86,7 +136,7 @@ TreeNode* function(void)
     TreeNode* t = newStmtNode(FuncK);
     match(FUNC);
     if (t != NULL && token == ID)
-        t->attr.name = copyString(tokenString);
+        setName(t);
     match(ID);
     match(LPAREN);
     if (t != NULL)
@@ -98,6 +148,8 @@ TreeNode* function(void)
     if (t != NULL)
         t->child[1] = stmt_sequence();
     match(END);
+    if (t != NULL && functionHook != NULL && !Error)
+        functionHook(t);
     return t;
 }
 
@@ -111,7 +163,7 @@ TreeNode* param_declare(void)
             getType(t);
         match(TYPE);
         if (t != NULL && token == ID)
-            t->attr.name = copyString(tokenString);
+            setName(t);
         match(ID);
     }
     TreeNode* p = t, * q;
@@ -123,7 +175,7 @@ TreeNode* param_declare(void)
             getType(q);
         match(TYPE);
         if (q != NULL && token == ID)
-            q->attr.name = copyString(tokenString);
+            setName(q);
         match(ID);
         if (q != NULL)
         {
@@ -174,8 +226,8 @@ TreeNode* statement(void)
     case TYPE: t = declare_stmt(); break;
     case RETURN: t = return_stmt(); break;
     default: syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        printToken(token, currentText());
+        nextToken();
         break;
     } /* end case */
     return t;
@@ -222,7 +274,7 @@ TreeNode* assign_stmt(void)
 {
     TreeNode* t = newStmtNode(AssignK);
     if ((t != NULL) && (token == ID))
-        t->attr.name = copyString(tokenString);
+        setName(t);
     match(ID);
     match(ASSIGN);
     if (t != NULL) t->child[0] = exp();
@@ -233,7 +285,7 @@ TreeNode * read_stmt(void)
 { TreeNode * t = newStmtNode(ReadK);
   match(READ);
   if ((t!=NULL) && (token==ID))
-    t->attr.name = copyString(tokenString);
+    setName(t);
   match(ID);
   return t;
 }
@@ -284,7 +336,7 @@ TreeNode* variable(void)
 {
     TreeNode* t = newExpNode(IdK);
     if (t != NULL && token == ID)
-        t->attr.name = copyString(tokenString);
+        setName(t);
     match(ID);
     if (token == LSQUARE)
     {
@@ -292,7 +344,7 @@ TreeNode* variable(void)
         if (t != NULL && token == INT)
         {
             char* left;
-            t->attr.val = strtol(tokenString, &left, 10);
+            t->attr.val = strtol(currentText(), &left, 10);
             if (strlen(left) > 0)
                 syntaxError("integer too long");
         }
@@ -362,7 +414,7 @@ TreeNode* factor(void)
         if (t != NULL && token == INT)
         {
             char* left;
-            t->attr.val = strtol(tokenString, &left, 10);
+            t->attr.val = strtol(currentText(), &left, 10);
             if (strlen(left) > 0)
                 syntaxError("integer too long");
         }
@@ -374,7 +426,7 @@ TreeNode* factor(void)
         {
             char* left;
             t->type = Float;
-            t->attr.fval = strtof(tokenString, &left);
+            t->attr.fval = strtof(currentText(), &left);
             if (strlen(left) > 0)
                 syntaxError("float too long");
         }
@@ -383,7 +435,7 @@ TreeNode* factor(void)
     case ID:
         t = newExpNode(IdK);
         if ((t != NULL) && (token == ID))
-            t->attr.name = copyString(tokenString);
+            setName(t);
         match(ID);
         if (token == LPAREN)
         {
@@ -413,8 +465,8 @@ TreeNode* factor(void)
         break;
     default:
         syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        printToken(token, currentText());
+        nextToken();
         break;
     }
     return t;
@@ -450,11 +502,20 @@ TreeNode* params(void)
 TreeNode* parse(void)
 {
     TreeNode* t = NULL;
-    token = getToken();
+    if (TokenStream)
+    {
+        scanAll();
+        tokenPos = -1;
+    }
+    nextToken();
     if (token == FUNC)
     {
-        t = func_sequence();
-        t->sibling = stmt_sequence();
+        TreeNode* p;
+        t = p = func_sequence();
+        /* the statements follow the last function */
+        while (p != NULL && p->sibling != NULL) p = p->sibling;
+        if (p != NULL) p->sibling = stmt_sequence();
+        else t = stmt_sequence();
     }
     else
         t = stmt_sequence();
@@ -13,4 +13,10 @@
  */
 TreeNode * parse(void);
 
+/* If functionHook is set, parse passes it each
+ * function as soon as the function is parsed
+ * (unless an error has occurred)
+ */
+extern void (* functionHook)(TreeNode *);
+
 #endif
@@ -0,0 +1,235 @@
+/****************************************************/
+/* File: peep.c                                     */
+/* Peephole optimizer for the TINY compiler         */
+/* The patterns are those of cgen.c: temporaries    */
+/* pushed at mp and loaded back once, and booleans  */
+/* made of 0/1 only to be tested by a jump          */
+/****************************************************/
+
+#include "globals.h"
+#include "code.h"
+#include "peep.h"
+
+/* the code buffer and its size */
+static TmWord * w;
+static int n;
+
+/* refs[loc] counts the jumps (and pc-relative
+ * address loads) that refer to loc
+ */
+static int * refs = NULL;
+
+/* MAXFOLLOW bounds the jumps followed when
+ * looking for the next use of ac
+ */
+#define MAXFOLLOW 8
+
+/* Function next returns the first location
+ * after loc holding an instruction, or n
+ */
+static int next( int loc )
+{ do ++loc; while (loc < n && w[loc].op == opEMPTY);
+  return loc;
+}
+
+/* Function live returns loc, or the first
+ * location after it holding an instruction
+ */
+static int live( int loc )
+{ return (loc < n && w[loc].op == opEMPTY) ? next(loc) : loc;
+}
+
+static void countRefs(void)
+{ int loc;
+  memset(refs, 0, (n+1)*sizeof(int));
+  for (loc=0;loc<n;++loc)
+    if (w[loc].op != opEMPTY && pcRelative(w[loc]))
+    { int target = loc+1+w[loc].d;
+      if (target >= 0 && target <= n) refs[target]++;
+    }
+}
+
+static void removeAt( int loc )
+{ w[loc].op = opEMPTY;
+}
+
+/* Function acDead is TRUE if the value in ac is
+ * overwritten (or the machine halts) before it is
+ * read, when control reaches loc
+ */
+static int acDead( int loc )
+{ int k;
+  for (k=0;k<MAXFOLLOW;++k)
+  { TmWord * x;
+    loc = live(loc);
+    if (loc < 0 || loc >= n) return TRUE;
+    x = &w[loc];
+    switch (x->op)
+    { case opHALT:
+        return TRUE;
+      case opIN:
+      case opLDC:
+        if (x->r == ac) return TRUE;
+        return FALSE;
+      case opLD:
+        return x->r == ac && x->s != ac;
+      case opLDA:
+        if (x->r == pc && x->s == pc)
+        { loc = loc+1+x->d; /* unconditional jump */
+          break;
+        }
+        return x->r == ac && x->s != ac;
+      default:
+        return FALSE;
+    }
+  }
+  return FALSE;
+}
+
+/* Function pushPop replaces
+ *     ST  ac,k(mp)     push left operand
+ *     op  ac,...       load right operand
+ *     LD  ac1,k(mp)    load left operand
+ * by a register move when the right operand
+ * takes a single instruction
+ */
+static int pushPop( int loc )
+{ int j = next(loc), m = next(j);
+  TmWord * st = &w[loc], * x = &w[j], * ld = &w[m];
+  if (m >= n || st->op != opST || st->r != ac || st->s != mp) return FALSE;
+  if (ld->op != opLD || ld->r != ac1 || ld->s != mp || ld->d != st->d)
+    return FALSE;
+  if (refs[j] != 0 || refs[m] != 0) return FALSE;
+  switch (x->op)
+  { case opLDC: break;
+    case opLD:
+      if (x->s == ac1 || (x->s == mp && x->d == st->d)) return FALSE;
+      break;
+    case opLDA:
+      if (x->s == ac1 || x->s == pc) return FALSE;
+      break;
+    default:
+      return FALSE;
+  }
+  if (x->r != ac) return FALSE;
+  /* LDA ac1,0(ac) copies ac to ac1 */
+  st->op = opLDA;
+  st->r = ac1;
+  st->d = 0;
+  st->s = ac;
+  removeAt(m);
+  return TRUE;
+}
+
+/* Function storeLoad removes the load in
+ *     ST  r,d(s)
+ *     LD  r,d(s)
+ * as r holds the value already
+ */
+static int storeLoad( int loc )
+{ int j = next(loc);
+  TmWord * st = &w[loc], * ld = &w[j];
+  if (j >= n || st->op != opST || ld->op != opLD || refs[j] != 0)
+    return FALSE;
+  if (ld->r != st->r || ld->d != st->d || ld->s != st->s || st->s == pc)
+    return FALSE;
+  removeAt(j);
+  return TRUE;
+}
+
+/* Function negate returns the jump taken when
+ * jump op is not
+ */
+static int negate( int op )
+{ switch (op)
+  { case opJLT: return opJGE;
+    case opJLE: return opJGT;
+    case opJGT: return opJLE;
+    case opJGE: return opJLT;
+    case opJEQ: return opJNE;
+    default:    return opJEQ;
+  }
+}
+
+/* Function compareJump replaces
+ *     Jcc ac,2(pc)     br if true
+ *     LDC ac,0(ac)     false case
+ *     LDA pc,1(pc)     unconditional jmp
+ *     LDC ac,1(ac)     true case
+ *     JEQ ac,d(pc)     jump if false (or JNE: if true)
+ * by the single jump, when the boolean is not
+ * used after it
+ */
+static int compareJump( int loc )
+{ TmWord * j = &w[loc];
+  TmWord * t;
+  if (loc+4 >= n) return FALSE;
+  t = &w[loc+4];
+  if (j->op < opJLT || j->op > opJNE || j->r != ac || j->s != pc || j->d != 2)
+    return FALSE;
+  if (w[loc+1].op != opLDC || w[loc+1].r != ac || w[loc+1].d != 0) return FALSE;
+  if (w[loc+2].op != opLDA || w[loc+2].r != pc || w[loc+2].s != pc
+      || w[loc+2].d != 1) return FALSE;
+  if (w[loc+3].op != opLDC || w[loc+3].r != ac || w[loc+3].d != 1) return FALSE;
+  if ((t->op != opJEQ && t->op != opJNE) || t->r != ac || t->s != pc)
+    return FALSE;
+  /* only the sequence itself may jump inside it */
+  if (refs[loc+1] != 0 || refs[loc+2] != 0 || refs[loc+3] != 1
+      || refs[loc+4] != 1) return FALSE;
+  if (!acDead(loc+5) || !acDead(loc+5+t->d)) return FALSE;
+  t->op = (t->op == opJEQ) ? negate(j->op) : j->op;
+  removeAt(loc);
+  removeAt(loc+1);
+  removeAt(loc+2);
+  removeAt(loc+3);
+  return TRUE;
+}
+
+/* Function jumpNext removes a jump that goes to
+ * the next instruction
+ */
+static int jumpNext( int loc )
+{ TmWord * x = &w[loc];
+  int target;
+  if (x->s != pc || (!(x->op >= opJLT && x->op <= opJNE)
+      && !(x->op == opLDA && x->r == pc))) return FALSE;
+  target = loc+1+x->d;
+  if (target < 0 || target > n || live(target) != next(loc)) return FALSE;
+  removeAt(loc);
+  return TRUE;
+}
+
+/* Procedure peephole improves the code in the
+ * code buffer of code.c before it is flushed:
+ * it removes redundant store/load pairs, folds
+ * comparisons into the jumps that test them and
+ * removes jumps to the next instruction
+ */
+void peephole(void)
+{ int loc, before, changed;
+  w = codeBuffer(&n);
+  if (n == 0) return;
+  refs = (int *) malloc((n+1)*sizeof(int));
+  if (refs == NULL)
+  { fprintf(listing,"Out of memory error in peephole optimizer\n");
+    exit(1);
+  }
+  before = 0;
+  for (loc=0;loc<n;++loc)
+    if (w[loc].op != opEMPTY) before++;
+  do
+  { changed = FALSE;
+    countRefs();
+    for (loc=0;loc<n;++loc)
+      if (w[loc].op != opEMPTY)
+        changed |= pushPop(loc) || storeLoad(loc) || compareJump(loc)
+                   || jumpNext(loc);
+  } while (changed);
+  free(refs);
+  refs = NULL;
+  codeCompact();
+  w = codeBuffer(&n);
+  if (TraceCode)
+    fprintf(listing,"Peephole optimization removed %d of %d instructions\n",
+            before-n,before);
+}
@@ -0,0 +1,18 @@
+/****************************************************/
+/* File: peep.h                                     */
+/* Peephole optimizer interface for the TINY        */
+/* compiler (works on the TM code buffer)           */
+/****************************************************/
+
+#ifndef _PEEP_H_
+#define _PEEP_H_
+
+/* Procedure peephole improves the code in the
+ * code buffer of code.c before it is flushed:
+ * it removes redundant store/load pairs, folds
+ * comparisons into the jumps that test them and
+ * removes jumps to the next instruction
+ */
+void peephole(void);
+
+#endif
@@ -8,54 +8,121 @@
 #include "globals.h"
 #include "util.h"
 #include "scan.h"
+#include "charscan.h"
 
 typedef enum
 /* states in scanner DFA */
 {
     START, INASSIGN, INCOMMENT1, ININT, INID, DONE,
-    DOT, INFLOAT, COMMENT2LEFT, COMMENT2RIGHT, INCOMMENT2
+    DOT, INFLOAT, COMMENT2LEFT, COMMENT2RIGHT, INCOMMENT2,
+    NUMSTATES
 }
 StateType;
 
 /* ֻ id  lexeme */
 char tokenString[MAXTOKENLEN + 1];
 
-/* BUFLEN = Դÿһ뻺ĳ */
-#define BUFLEN 256
-
-static char lineBuf[BUFLEN]; /* л */
-static int linepos = 0; /* ָ lineBuf һȡַ */
-static int bufsize = 0; /* ǰַʵʴС */
+/* the whole source file is read into srcBuf once
+ * and walked with srcPos; lineEnd marks the start
+ * of the first line not yet counted in lineno
+ */
+static char* srcBuf = NULL;
+static const char* srcPos = NULL;
+static const char* srcEnd = NULL;
+static const char* lineEnd = NULL;
 static int EOF_flag = FALSE; /* corrects ungetNextChar behavior on EOF */
 
-/*  lineBuf лȡһǿַ
- lineBuf ľȡٷ
-ļĩβ EOF  EOF ־λ*/
-static int getNextChar(void)
+/* SRCCHUNK = initial size of the source buffer */
+#define SRCCHUNK 65536
+
+static char emptySource[SCANPAD + 1];
+
+/* loadSource reads the whole source file into
+ * srcBuf with block reads; there is no limit on
+ * the length of a source line. The buffer is
+ * terminated by a '\0' sentinel and SCANPAD bytes
+ * of zero padding, so that runs of characters can
+ * be scanned many bytes at a time
+ */
+static void loadSource(void)
 {
-    if (!(linepos < bufsize)) // 
+    size_t cap = SRCCHUNK, len = 0, n;
+    srcBuf = (char*)malloc(cap + SCANPAD + 1);
+    while (srcBuf != NULL && (n = fread(srcBuf + len, 1, cap - len, source)) > 0)
     {
-        lineno++;
-        if (fgets(lineBuf, BUFLEN - 1, source))
+        len += n;
+        if (len == cap)
         {
-            if (EchoSource) fprintf(listing, "%4d: %s", lineno, lineBuf);
-            bufsize = strlen(lineBuf);
-            linepos = 0;
-            return lineBuf[linepos++];
-        }
-        else
-        {
-            EOF_flag = TRUE;
-            return EOF;
+            char* p = (char*)realloc(srcBuf, (cap *= 2) + SCANPAD + 1);
+            if (p == NULL) free(srcBuf);
+            srcBuf = p;
         }
     }
-    else return lineBuf[linepos++]; // ֱӷһַ
+    if (srcBuf == NULL)
+    {
+        fprintf(listing, "Out of memory error reading source\n");
+        Error = TRUE;
+        len = 0;
+        srcBuf = emptySource;
+    }
+    memset(srcBuf + len, 0, SCANPAD + 1);
+    srcPos = lineEnd = srcBuf;
+    srcEnd = srcBuf + len;
 }
 
-/* ָ˵һַûеļĩβ */
+/* newLine counts the line starting at lineEnd and
+ * echoes it to the listing if EchoSource is set
+ */
+static void newLine(void)
+{
+    const char* start = lineEnd;
+    const char* nl = (const char*)memchr(start, '\n', srcEnd - start);
+    lineEnd = (nl == NULL) ? srcEnd : nl + 1;
+    lineno++;
+    if (EchoSource)
+    {
+        fprintf(listing, "%4d: ", lineno);
+        fwrite(start, 1, lineEnd - start, listing);
+    }
+}
+
+/* getNextChar returns the next character of the
+ * source buffer, counting a new line whenever its
+ * first character is fetched; at the end of the
+ * buffer it returns EOF and sets EOF_flag. Inside
+ * a counted line it makes a single test, as the
+ * line buffer did: lineEnd never passes srcEnd
+ */
+static int getNextChar(void)
+{
+    if (srcPos < lineEnd) return (unsigned char)*srcPos++;
+    if (srcBuf == NULL) loadSource();
+    if (srcPos >= srcEnd)
+    {
+        lineno++;
+        EOF_flag = TRUE;
+        return EOF;
+    }
+    newLine();
+    return (unsigned char)*srcPos++;
+}
+
+/* advanceTo moves srcPos to p, counting (and
+ * echoing) every line whose first character lies
+ * in the skipped part of the buffer
+ */
+static void advanceTo(const char* p)
+{
+    while (p > lineEnd) newLine();
+    srcPos = p;
+}
+
+/* ungetNextChar backtracks one character in the
+ * source buffer (not at end of file)
+ */
 static void ungetNextChar(void)
 {
-    if (!EOF_flag) linepos--;
+    if (!EOF_flag) srcPos--;
 }
 
 /* ӳ */
@@ -70,238 +137,333 @@ static struct
     {"func",FUNC}, {"return",RETURN}, {"while",WHILE}, {"void",TYPE}, {"integer",TYPE}, {"boolean",TYPE}, {"float",TYPE}
 };
 
-/* ѯһ ID  token ǷΪ֣Բң */
-static TokenType reservedLookup(char* s)
+/* reserved words are found through a perfect hash
+ * that is generated from reservedWords on first use,
+ * so the table above stays the only list of keywords.
+ * The hash mixes the first two characters, the last
+ * character and the length; reservedSeed is searched
+ * until every reserved word lands in its own slot
+ */
+#define MAXRESHASH 256
+
+static unsigned char reservedHash[MAXRESHASH]; /* slot -> index+1, 0 = empty */
+static unsigned char reservedLen[MAXRESERVED]; /* length of each reserved word */
+static unsigned reservedMask = 0; /* hash table size - 1, 0 until built */
+static unsigned reservedSeed;
+static int reservedMinLen, reservedMaxLen;
+
+static unsigned reservedSlot(const char* s, int len, unsigned seed)
 {
-    int i;
+    unsigned h = (unsigned char)s[0] * seed + (unsigned char)s[1];
+    return (h * seed + (unsigned char)s[len - 1] + len) & reservedMask;
+}
+
+/* buildReservedHash picks the smallest table and the
+ * first seed that give a collision-free hash
+ */
+static void buildReservedHash(void)
+{
+    int i, len;
+    reservedMinLen = MAXTOKENLEN;
+    reservedMaxLen = 0;
     for (i = 0; i < MAXRESERVED; i++)
-        if (!strcmp(s, reservedWords[i].str))
-            return reservedWords[i].tok;
+    {
+        len = (int)strlen(reservedWords[i].str);
+        reservedLen[i] = (unsigned char)len;
+        if (len < reservedMinLen) reservedMinLen = len;
+        if (len > reservedMaxLen) reservedMaxLen = len;
+    }
+    for (reservedMask = 63; reservedMask < MAXRESHASH; reservedMask = reservedMask * 2 + 1)
+        for (reservedSeed = 1; reservedSeed < 65536; reservedSeed++)
+        {
+            memset(reservedHash, 0, sizeof(reservedHash));
+            for (i = 0; i < MAXRESERVED; i++)
+            {
+                char* s = reservedWords[i].str;
+                unsigned h = reservedSlot(s, (int)strlen(s), reservedSeed);
+                if (reservedHash[h] != 0) break;
+                reservedHash[h] = (unsigned char)(i + 1);
+            }
+            if (i == MAXRESERVED) return;
+        }
+    fprintf(listing, "Scanner Bug: no perfect hash for reserved words\n");
+    exit(1);
+}
+
+/* reservedLookup returns the token of reserved word
+ * s of length len, or ID; it does at most one
+ * string comparison, and only against a word of
+ * the same length
+ */
+static TokenType reservedLookup(const char* s, int len)
+{
+    int i;
+    if (reservedMask == 0) buildReservedHash();
+    if (len < reservedMinLen || len > reservedMaxLen) return ID;
+    i = reservedHash[reservedSlot(s, len, reservedSeed)];
+    if (i != 0 && reservedLen[i - 1] == len && !memcmp(s, reservedWords[i - 1].str, len))
+        return reservedWords[i - 1].tok;
     return ID;
 }
 
+/* character classes of the scanner DFA */
+typedef enum
+{
+    CC_OTHER, CC_DIGIT, CC_LETTER, CC_SPACE, CC_COLON, CC_LBRACE,
+    CC_RBRACE, CC_SLASH, CC_STAR, CC_DOT, CC_EQ, CC_LT, CC_PLUS,
+    CC_MINUS, CC_LPAREN, CC_RPAREN, CC_LSQUARE, CC_RSQUARE, CC_COMMA,
+    CC_SEMI, CC_EOF,
+    NUMCLASSES
+}
+CharClass;
+
+/* charClass maps every character to its class;
+ * it is indexed by c+1 so that EOF (-1) has a slot
+ */
+static unsigned char charClass[257];
+#define CLASSOF(c) charClass[(c) + 1]
+
+/* flags of a DFA transition */
+#define T_SAVE  1 /* character is part of the lexeme */
+#define T_UNGET 2 /* character is pushed back */
+
+typedef struct
+{
+    unsigned char next;  /* next state */
+    unsigned char flags; /* T_SAVE, T_UNGET */
+    unsigned char token; /* token recognized when next is DONE */
+}
+Transition;
+
+static Transition transition[NUMSTATES][NUMCLASSES];
+
+/* runSkip[s] skips the characters that keep the DFA
+ * in state s (in comments, all characters that cannot
+ * end the comment); these runs are consumed by the
+ * charscan kernels many bytes at a time
+ */
+static ScanRunProc runSkip[NUMSTATES];
+
+/* SHORTRUN = length of run checked one character at
+ * a time before a kernel is called; most identifiers
+ * and gaps between tokens are shorter than that
+ */
+#define SHORTRUN 8
+
+static void setTrans(StateType s, CharClass cc, StateType next, int flags, TokenType tok)
+{
+    transition[s][cc].next = (unsigned char)next;
+    transition[s][cc].flags = (unsigned char)flags;
+    transition[s][cc].token = (unsigned char)tok;
+}
+
+/* setAllTrans sets the transition of state s for all classes */
+static void setAllTrans(StateType s, StateType next, int flags, TokenType tok)
+{
+    int cc;
+    for (cc = 0; cc < NUMCLASSES; cc++)
+        setTrans(s, cc, next, flags, tok);
+}
+
+/* initScanTables builds the character class and
+ * transition tables of the scanner DFA
+ */
+static void initScanTables(void)
+{
+    static const struct { char c; CharClass cc; TokenType tok; } single[] = {
+        {'=',CC_EQ,EQ}, {'<',CC_LT,LT}, {'+',CC_PLUS,PLUS}, {'-',CC_MINUS,MINUS},
+        {'*',CC_STAR,TIMES}, {'(',CC_LPAREN,LPAREN}, {')',CC_RPAREN,RPAREN},
+        {'[',CC_LSQUARE,LSQUARE}, {']',CC_RSQUARE,RSQUARE}, {',',CC_COMMA,COMMA},
+        {';',CC_SEMI,SEMI}
+    };
+    int c, i;
+    for (c = 0; c < 256; c++)
+    {
+        CharClass cc = CC_OTHER;
+        if (c >= '0' && c <= '9') cc = CC_DIGIT;
+        else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) cc = CC_LETTER;
+        CLASSOF(c) = (unsigned char)cc;
+    }
+    CLASSOF(EOF) = CC_EOF;
+    CLASSOF(' ') = CLASSOF('\t') = CLASSOF('\n') = CC_SPACE;
+    CLASSOF(':') = CC_COLON;
+    CLASSOF('{') = CC_LBRACE;
+    CLASSOF('}') = CC_RBRACE;
+    CLASSOF('/') = CC_SLASH;
+    CLASSOF('.') = CC_DOT;
+    for (i = 0; i < (int)(sizeof(single) / sizeof(single[0])); i++)
+        CLASSOF((unsigned char)single[i].c) = (unsigned char)single[i].cc;
+
+    /* START */
+    setAllTrans(START, DONE, T_SAVE, ERROR);
+    for (i = 0; i < (int)(sizeof(single) / sizeof(single[0])); i++)
+        setTrans(START, single[i].cc, DONE, T_SAVE, single[i].tok);
+    setTrans(START, CC_DIGIT, ININT, T_SAVE, ERROR);
+    setTrans(START, CC_LETTER, INID, T_SAVE, ERROR);
+    setTrans(START, CC_COLON, INASSIGN, T_SAVE, ERROR);
+    setTrans(START, CC_SPACE, START, 0, ERROR);
+    setTrans(START, CC_LBRACE, INCOMMENT1, 0, ERROR);
+    setTrans(START, CC_SLASH, COMMENT2LEFT, 0, ERROR);
+    setTrans(START, CC_EOF, DONE, 0, ENDFILE);
+    /* { ... } comments */
+    setAllTrans(INCOMMENT1, INCOMMENT1, 0, ERROR);
+    setTrans(INCOMMENT1, CC_RBRACE, START, 0, ERROR);
+    setTrans(INCOMMENT1, CC_EOF, DONE, 0, ENDFILE);
+    /* '/' is either a division or opens a comment */
+    setAllTrans(COMMENT2LEFT, DONE, T_UNGET, DIV);
+    setTrans(COMMENT2LEFT, CC_STAR, INCOMMENT2, 0, ERROR);
+    /* comment bodies */
+    setAllTrans(INCOMMENT2, INCOMMENT2, 0, ERROR);
+    setTrans(INCOMMENT2, CC_STAR, COMMENT2RIGHT, 0, ERROR);
+    setTrans(INCOMMENT2, CC_EOF, DONE, 0, ENDFILE);
+    setAllTrans(COMMENT2RIGHT, INCOMMENT2, 0, ERROR);
+    setTrans(COMMENT2RIGHT, CC_STAR, COMMENT2RIGHT, 0, ERROR);
+    setTrans(COMMENT2RIGHT, CC_SLASH, START, 0, ERROR);
+    setTrans(COMMENT2RIGHT, CC_EOF, DONE, 0, ENDFILE);
+    /* := */
+    setAllTrans(INASSIGN, DONE, T_UNGET, ERROR);
+    setTrans(INASSIGN, CC_EQ, DONE, T_SAVE, ASSIGN);
+    /* numbers */
+    setAllTrans(ININT, DONE, T_UNGET, INT);
+    setTrans(ININT, CC_DIGIT, ININT, T_SAVE, ERROR);
+    setTrans(ININT, CC_DOT, DOT, T_SAVE, ERROR);
+    setAllTrans(DOT, DONE, T_UNGET, ERROR);
+    setTrans(DOT, CC_DIGIT, INFLOAT, T_SAVE, ERROR);
+    setAllTrans(INFLOAT, DONE, T_UNGET, FLOAT);
+    setTrans(INFLOAT, CC_DIGIT, INFLOAT, T_SAVE, ERROR);
+    /* identifiers */
+    setAllTrans(INID, DONE, T_UNGET, ID);
+    setTrans(INID, CC_LETTER, INID, T_SAVE, ERROR);
+
+    initCharScan();
+    runSkip[START] = scanSpaces;
+    runSkip[INCOMMENT1] = scanToRBrace;
+    runSkip[INCOMMENT2] = scanToStar;
+    runSkip[ININT] = scanDigits;
+    runSkip[INFLOAT] = scanDigits;
+    runSkip[INID] = scanLetters;
+}
+
+/* skipRun consumes the characters that keep the DFA
+ * in state s, switching to the vector kernel only
+ * for runs longer than SHORTRUN
+ */
+static void skipRun(StateType s)
+{
+    const char* p = srcPos;
+    const char* stop = (srcEnd - p > SHORTRUN) ? p + SHORTRUN : srcEnd;
+    while (p < stop && transition[s][charClass[(unsigned char)*p + 1]].next == s)
+        p++;
+    if (p == stop && p < srcEnd)
+        p = runSkip[s](p, srcEnd);
+    if (p != srcPos) advanceTo(p);
+}
+
+/* position and length of the lexeme of the last
+ * token returned by getToken
+ */
+static int lexemeOffset = 0;
+static int lexemeLength = 0;
+
 /****************************************/
 /* the primary function of the scanner  */
 /****************************************/
 
-/* Դһ token */
+/* getToken runs the table-driven DFA from START
+ * until it reaches DONE. The lexeme of a token is
+ * always contiguous in the source buffer, so it is
+ * copied to tokenString once the token is complete
+ */
 TokenType getToken(void)
-{  
-    /* tokenString дһַ± */
-    int tokenStringIndex = 0;
-    /* ݴ浱ǰҪص token */
-    TokenType currentToken;
+{
+    /* first character of the current lexeme */
+    const char* tokenStart = NULL;
     /* current state - always begins at START */
     StateType state = START;
-    /* ɱ浽 tokenString ı־ */
-    int save;
-    while (state != DONE)
+    TokenType currentToken;
+    int len;
+    if (srcBuf == NULL)
     {
-        char c = getNextChar();
-        save = TRUE;
-        switch (state)
-        {
-        case START: {
-            if (isdigit(c))
-                state = ININT;
-            else if (isalpha(c))
-                state = INID;
-            else if (c == ':')
-                state = INASSIGN;
-            else if ((c == ' ') || (c == '\t') || (c == '\n'))
-                save = FALSE;
-            else if (c == '{')
-            {
-                save = FALSE;
-                state = INCOMMENT1;
-            }
-            else if (c == '/')
-            {
-                save = FALSE;
-                state = COMMENT2LEFT;
-            }
-            else // ǣ֡ĸ':' '{' ' ' '\t' '\n''/'
-            {
-                state = DONE;
-                switch (c)
-                {
-                case EOF:
-                    save = FALSE;
-                    currentToken = ENDFILE;
-                    break;
-                case '=':
-                    currentToken = EQ;
-                    break;
-                case '<':
-                    currentToken = LT;
-                    break;
-                case '+':
-                    currentToken = PLUS;
-                    break;
-                case '-':
-                    currentToken = MINUS;
-                    break;
-                case '*':
-                    currentToken = TIMES;
-                    break;
-                /*case '/':
-                    currentToken = DIV;
-                    break;*/
-                case '(':
-                    currentToken = LPAREN;
-                    break;
-                case ')':
-                    currentToken = RPAREN;
-                    break;
-                case '[':
-                    currentToken = LSQUARE;
-                    break;
-                case ']':
-                    currentToken = RSQUARE;
-                    break;
-                case ',':
-                    currentToken = COMMA;
-                    break;
-                case ';':
-                    currentToken = SEMI;
-                    break;
-                default:
-                    currentToken = ERROR;
-                    break;
-                }
-            }
-            break;
-        }
-        case INCOMMENT1: {
-            save = FALSE;
-            if (c == EOF)
-            {
-                state = DONE;
-                currentToken = ENDFILE;
-            }
-            else if (c == '}')
-                state = START;
-            break;
-        }
-        case COMMENT2LEFT: {
-            save = FALSE;
-            if (c == '*')
-                state = INCOMMENT2;
-            else {
-                ungetNextChar();
-                state = DONE;
-                currentToken = DIV;
-                break;
-            }
-        }
-        case INCOMMENT2: {
-            save = FALSE;
-            if (c == EOF)
-            {
-                state = DONE;
-                currentToken = ENDFILE;
-            }
-            else if (c == '*')
-                state = COMMENT2RIGHT;
-            break;
-        }
-        case COMMENT2RIGHT: {
-            save = FALSE;
-            if (c == EOF)
-            {
-                state = DONE;
-                currentToken = ENDFILE;
-            }
-            else if (c == '/')
-                state = START;
-            else if (c != '*')
-                state = INCOMMENT2;
-            break;
-        }
-        case INASSIGN: {
-            state = DONE;
-            if (c == '=')
-                currentToken = ASSIGN;
-            else
-            { /* backup in the input */
-                ungetNextChar();
-                save = FALSE;
-                currentToken = ERROR;
-            }
-            break;
-        }
-        case ININT: {
-            if (c == '.') // float
-                state = DOT;
-            //else if (c == ' ' || c == '+' || c == '-' || c == '*' || c == '/'
-            //    || c == ';' || c == '<' || c == '=' || c == '{')
-            //{ // ո񡢷ֺŻע͵Ŀͷ
-            //    ungetNextChar();
-            //    save = FALSE;
-            //    state = DONE;
-            //    currentToken = INT;
-            //}
-            else if (!isdigit(c))
-            {
-                ungetNextChar();
-                save = FALSE;
-                state = DONE;
-                currentToken = INT;
-            }
-            break;
-        }
-        case DOT: {
-            if (isdigit(c))
-                state = INFLOAT;
-            else
-            {
-                ungetNextChar();
-                save = FALSE;
-                state = DONE;
-                currentToken = ERROR;
-            }
-            break;
-        }
-        case INFLOAT: {
-            if (!isdigit(c))
-            {
-                ungetNextChar();
-                save = FALSE;
-                state = DONE;
-                currentToken = FLOAT;
-            }
-            break;
-        }
-        case INID: {
-            if (!isalpha(c))
-            { /* backup in the input */
-                ungetNextChar();
-                save = FALSE;
-                state = DONE;
-                currentToken = ID;
-            }
-            break;
-        }
-        case DONE:
-        default: /* should never happen */ {
-            fprintf(listing, "Scanner Bug: state= %d\n", state);
-            state = DONE;
-            currentToken = ERROR;
-            break;
-        }
-        }
-        if ((save) && (tokenStringIndex <= MAXTOKENLEN))
-            tokenString[tokenStringIndex++] = (char)c;
+        loadSource();
+        initScanTables();
+    }
+    for (;;)
+    {
+        int c;
+        if (runSkip[state] != NULL)
+            skipRun(state);
+        c = getNextChar();
+
+        const Transition* t = &transition[state][CLASSOF(c)];
+        if ((t->flags & T_SAVE) && state == START)
+            tokenStart = srcPos - 1;
+        if (t->flags & T_UNGET)
+            ungetNextChar();
+        state = (StateType)t->next;
         if (state == DONE)
         {
-            tokenString[tokenStringIndex] = '\0';
-            if (currentToken == ID)
-                currentToken = reservedLookup(tokenString);
+            currentToken = (TokenType)t->token;
+            break;
         }
     }
+    if (tokenStart == NULL) tokenStart = srcPos;
+    len = (int)(srcPos - tokenStart);
+    if (len > MAXTOKENLEN) len = MAXTOKENLEN;
+    memcpy(tokenString, tokenStart, len);
+    tokenString[len] = '\0';
+    lexemeOffset = (int)(tokenStart - srcBuf);
+    lexemeLength = len;
+    if (currentToken == ID)
+        currentToken = reservedLookup(tokenString, len);
     if (TraceScan) {
-        fprintf(listing, "\t%2d: ", lineno); // ӡ token к
-        printToken(currentToken, tokenString); // ӡ token
+        fprintf(listing, "\t%2d: ", lineno);
+        printToken(currentToken, tokenString);
     }
     return currentToken;
 } /* end getToken */
+
+/* the token stream built by scanAll */
+TokenRec* tokenStream = NULL;
+int tokenCount = 0;
+
+/* Function scanAll tokenizes the whole source into
+ * tokenStream and returns the number of tokens; the
+ * last token is always ENDFILE
+ */
+int scanAll(void)
+{
+    int cap = 1024;
+    TokenType t;
+    tokenStream = (TokenRec*)malloc(cap * sizeof(TokenRec));
+    tokenCount = 0;
+    do
+    {
+        t = getToken();
+        if (tokenCount == cap)
+        {
+            TokenRec* p = (TokenRec*)realloc(tokenStream, (cap *= 2) * sizeof(TokenRec));
+            if (p == NULL) free(tokenStream);
+            tokenStream = p;
+        }
+        if (tokenStream == NULL)
+        {
+            fprintf(listing, "Out of memory error at line %d\n", lineno);
+            exit(1);
+        }
+        tokenStream[tokenCount].type = t;
+        tokenStream[tokenCount].offset = lexemeOffset;
+        tokenStream[tokenCount].length = lexemeLength;
+        tokenStream[tokenCount].lineno = lineno;
+        tokenCount++;
+    } while (t != ENDFILE);
+    return tokenCount;
+}
+
+/* Function tokenText returns the lexeme of token r
+ * inside the source buffer; it is not terminated,
+ * so only r->length characters belong to it
+ */
+char* tokenText(const TokenRec* r)
+{
+    return srcBuf + r->offset;
+}
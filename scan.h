@@ -17,4 +17,32 @@ extern char tokenString[MAXTOKENLEN+1];
 /* Դһ token */
 TokenType getToken(void);
 
+/* TokenRec is one token of the token stream; its
+ * lexeme is the length characters of the source
+ * buffer starting at offset
+ */
+typedef struct
+{
+    TokenType type;
+    int offset;
+    int length;
+    int lineno;
+} TokenRec;
+
+/* the token stream built by scanAll */
+extern TokenRec* tokenStream;
+extern int tokenCount;
+
+/* Function scanAll tokenizes the whole source into
+ * tokenStream and returns the number of tokens; the
+ * last token is always ENDFILE
+ */
+int scanAll(void);
+
+/* Function tokenText returns the lexeme of token r
+ * inside the source buffer; it is not terminated,
+ * so only r->length characters belong to it
+ */
+char* tokenText(const TokenRec* r);
+
 #endif
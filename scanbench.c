@@ -0,0 +1,47 @@
+/****************************************************/
+/* File: scanbench.c                                */
+/* Scanner benchmark for the TINY compiler: scans   */
+/* a source file to the end and reports tokens per  */
+/* second; the input is usually written by gentiny  */
+/****************************************************/
+
+#include "globals.h"
+#include "scan.h"
+#include <time.h>
+
+/* the globals of main.c that the scanner uses */
+int lineno = 0;
+FILE * source;
+FILE * listing;
+FILE * code;
+
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+
+int Error = FALSE;
+
+int main( int argc, char * argv[] )
+{ long tokens = 0;
+  clock_t start;
+  double secs;
+  if (argc != 2)
+  { fprintf(stderr,"usage: %s <filename>\n",argv[0]);
+    exit(1);
+  }
+  source = fopen(argv[1],"r");
+  if (source == NULL)
+  { fprintf(stderr,"File %s not found\n",argv[1]);
+    exit(1);
+  }
+  listing = stdout;
+  /* the time includes reading the file, which the
+     scanner does on its first token */
+  start = clock();
+  while (getToken() != ENDFILE) tokens++;
+  secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+  fclose(source);
+  printf("%ld tokens in %d lines scanned in %.3f s",tokens,lineno,secs);
+  if (secs > 0) printf(" (%.0f tokens/sec)",tokens / secs);
+  printf("\n");
+  return Error ? 1 : 0;
+}
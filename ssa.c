@@ -0,0 +1,287 @@
+/****************************************************/
+/* File: ssa.c                                      */
+/* Static single assignment form of the IR code     */
+/* for the TINY compiler: phis are placed on the    */
+/* iterated dominance frontiers of the definitions  */
+/* of variables live across blocks (semi-pruned     */
+/* SSA), then variables are renamed by a walk of    */
+/* the dominator tree                               */
+/****************************************************/
+
+#include "globals.h"
+#include "ir.h"
+#include "ssa.h"
+
+/* the dominance frontiers: those of block b are
+ * dfList[dfStart[b]] up to dfList[dfStart[b+1]-1]
+ */
+static int * dfStart, * dfList;
+
+/* Procedure frontiers computes the dominance
+ * frontiers: a join block is in the frontier of
+ * each block on the dominator tree paths from its
+ * predecessors up to its immediate dominator
+ */
+static void frontiers( void )
+{ int pass, k, j, b;
+  dfStart = (int *) calloc(nBlock+1, sizeof(int));
+  if (dfStart == NULL) irNoMemory();
+  dfList = NULL;
+  /* pass 0 counts, pass 1 fills */
+  for (pass=0;pass<2;++pass)
+  { for (k=0;k<nOrder;++k)
+    { b = irOrder[k];
+      if (irBlock[b].npred < 2) continue;
+      for (j=0;j<irBlock[b].npred;++j)
+      { int r = irBlock[b].pred[j];
+        while (r != irBlock[b].idom)
+        { if (pass == 0) dfStart[r+1]++;
+          else dfList[dfStart[r]++] = b;
+          r = irBlock[r].idom;
+        }
+      }
+    }
+    if (pass == 0)
+    { for (b=0;b<nBlock;++b) dfStart[b+1] += dfStart[b];
+      dfList = (int *) malloc((dfStart[nBlock]+1)*sizeof(int));
+      if (dfList == NULL) irNoMemory();
+    }
+  }
+  for (b=nBlock;b>0;--b) dfStart[b] = dfStart[b-1];
+  dfStart[0] = 0;
+}
+
+/* Procedure placePhis inserts an empty phi for
+ * variable v at the start of each block of the
+ * iterated dominance frontier of its definitions
+ */
+static void placePhis( void )
+{ int * global = (int *) calloc(nValue, sizeof(int));
+  int * killed = (int *) malloc(nValue*sizeof(int));
+  int * defStart = (int *) calloc(nValue+1, sizeof(int));
+  int * defList, * work, * hasPhi, * inWork;
+  int b, i, k, v, n;
+  if (global == NULL || killed == NULL || defStart == NULL) irNoMemory();
+  for (v=0;v<nValue;++v) killed[v] = -1;
+  /* a variable read before it is assigned in some
+     block is live across blocks: it needs phis */
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+      { IrInstr * x = &irInstr[i];
+        if (x->a >= 0 && irValue[x->a].var && killed[x->a] != b)
+          global[x->a] = TRUE;
+        if (x->b >= 0 && irValue[x->b].var && killed[x->b] != b)
+          global[x->b] = TRUE;
+        if (x->dst >= 0 && irValue[x->dst].var)
+        { if (killed[x->dst] != b) defStart[x->dst+1]++;
+          killed[x->dst] = b;
+        }
+      }
+  /* the blocks assigning each variable */
+  for (v=0;v<nValue;++v) defStart[v+1] += defStart[v];
+  defList = (int *) malloc((defStart[nValue]+1)*sizeof(int));
+  if (defList == NULL) irNoMemory();
+  for (v=0;v<nValue;++v) killed[v] = -1;
+  for (b=0;b<nBlock;++b)
+    if (!irBlock[b].dead)
+      for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+      { int d = irInstr[i].dst;
+        if (d >= 0 && irValue[d].var && killed[d] != b)
+        { defList[defStart[d]++] = b;
+          killed[d] = b;
+        }
+      }
+  for (v=nValue;v>0;--v) defStart[v] = defStart[v-1];
+  defStart[0] = 0;
+  work = (int *) malloc((nBlock+1)*sizeof(int));
+  hasPhi = (int *) malloc((nBlock+1)*sizeof(int));
+  inWork = (int *) malloc((nBlock+1)*sizeof(int));
+  if (work == NULL || hasPhi == NULL || inWork == NULL) irNoMemory();
+  for (b=0;b<nBlock;++b) hasPhi[b] = inWork[b] = -1;
+  for (v=0;v<nValue;++v)
+  { if (!global[v]) continue;
+    n = 0;
+    for (k=defStart[v];k<defStart[v+1];++k)
+    { work[n++] = defList[k];
+      inWork[defList[k]] = v;
+    }
+    while (n > 0)
+    { b = work[--n];
+      for (k=dfStart[b];k<dfStart[b+1];++k)
+      { int d = dfList[k];
+        if (hasPhi[d] == v) continue;
+        i = newInstr(IrPhi, v, -1, -1);
+        irInstr[i].val = v;
+        irInstr[i].args = (int *) malloc((irBlock[d].npred+1)*sizeof(int));
+        if (irInstr[i].args == NULL) irNoMemory();
+        irPrepend(d, i);
+        hasPhi[d] = v;
+        if (inWork[d] != v)
+        { inWork[d] = v;
+          work[n++] = d;
+        }
+      }
+    }
+  }
+  free(global); free(killed); free(defStart); free(defList);
+  free(work); free(hasPhi); free(inWork);
+}
+
+/* the renaming: cur[v] is the value variable v
+ * holds at the point reached, and the log keeps
+ * the values it replaced, to be put back when
+ * the walk leaves the block
+ */
+static int * cur;
+static int * logVar, * logOld;
+static int nlog, maxlog;
+
+static void define( int v, int value )
+{ if (nlog == maxlog)
+  { maxlog = maxlog ? 2*maxlog : 256;
+    logVar = (int *) realloc(logVar, maxlog*sizeof(int));
+    logOld = (int *) realloc(logOld, maxlog*sizeof(int));
+    if (logVar == NULL || logOld == NULL) irNoMemory();
+  }
+  logVar[nlog] = v;
+  logOld[nlog++] = cur[v];
+  cur[v] = value;
+}
+
+/* Procedure renameBlock renames the variables
+ * read and assigned in block b, and fills in the
+ * phi arguments of its successors
+ */
+static void renameBlock( int b )
+{ int i, k;
+  for (i=irBlock[b].first;i>=0;i=irInstr[i].next)
+  { IrInstr * x = &irInstr[i];
+    if (x->op != IrPhi)
+    { if (x->a >= 0 && irValue[x->a].var) x->a = cur[x->a];
+      if (x->b >= 0 && irValue[x->b].var) x->b = cur[x->b];
+    }
+    if (x->dst >= 0 && irValue[x->dst].var)
+    { int v = x->dst;
+      int d = newValue(irValue[v].type, irValue[v].atom);
+      x->dst = d;
+      irValue[d].def = i;
+      define(v, d);
+    }
+  }
+  for (k=0;k<2;++k)
+  { int s = irBlock[b].succ[k], j;
+    if (s < 0) continue;
+    j = irPredIndex(s, b);
+    for (i=irBlock[s].first;i>=0;i=irInstr[i].next)
+      if (irInstr[i].op == IrPhi)
+        irInstr[i].args[j] = cur[irInstr[i].val];
+  }
+}
+
+void toSSA( void )
+{ int * stack, * mark, top = 0, v;
+  irDominators();
+  frontiers();
+  placePhis();
+  free(dfStart);
+  free(dfList);
+  cur = (int *) malloc((nValue+1)*sizeof(int));
+  stack = (int *) malloc((nBlock+1)*sizeof(int));
+  mark = (int *) malloc((nBlock+1)*sizeof(int));
+  if (cur == NULL || stack == NULL || mark == NULL) irNoMemory();
+  for (v=0;v<nValue;++v) cur[v] = -1;
+  nlog = maxlog = 0;
+  logVar = logOld = NULL;
+  /* preorder walk of the dominator tree; a block
+     stays on the stack until its children are done */
+  stack[top++] = 0;
+  mark[0] = nlog;
+  renameBlock(0);
+  while (top > 0)
+  { int b = stack[top-1], c = irBlock[b].domChild;
+    if (c >= 0)
+    { /* descend to the next child */
+      irBlock[b].domChild = irBlock[c].domSibling;
+      mark[c] = nlog;
+      renameBlock(c);
+      stack[top++] = c;
+    }
+    else
+    { while (nlog > mark[b])
+      { nlog--;
+        cur[logVar[nlog]] = logOld[nlog];
+      }
+      top--;
+    }
+  }
+  free(cur); free(stack); free(mark);
+  free(logVar); free(logOld);
+  /* the walk used up the dominator tree */
+  irDominators();
+}
+
+/* Procedure sequence appends to the chain *first
+ * ... *last the copies dst[k] := src[k] for
+ * k < n, as if done at once: a copy is made once
+ * no other reads its destination, and a cycle is
+ * broken by saving a destination in a temporary
+ */
+static void sequence( int * dst, int * src, int n, int * first, int * last )
+{ int k, j;
+  while (n > 0)
+  { int found = -1, i;
+    for (k=0;k<n && found<0;++k)
+    { found = k;
+      for (j=0;j<n;++j)
+        if (j != k && src[j] == dst[k]) { found = -1; break; }
+    }
+    if (found < 0)
+    { /* all copies are on cycles */
+      int t = newValue(irValue[dst[0]].type, 0);
+      i = newInstr(IrCopy, t, dst[0], -1);
+      for (j=0;j<n;++j)
+        if (src[j] == dst[0]) src[j] = t;
+    }
+    else
+    { i = newInstr(IrCopy, dst[found], src[found], -1);
+      dst[found] = dst[n-1];
+      src[found] = src[n-1];
+      n--;
+    }
+    if (*first < 0) *first = i;
+    else irInstr[*last].next = i;
+    *last = i;
+  }
+}
+
+void fromSSA( void )
+{ int * dst = NULL, * src = NULL, max = 0, b, j, i;
+  for (b=0;b<nBlock;++b)
+  { IrBlock * t = &irBlock[b];
+    if (t->dead) continue;
+    for (j=0;j<t->npred;++j)
+    { int n = 0, first = -1, last = -1;
+      for (i=t->first;i>=0;i=irInstr[i].next)
+      { if (irInstr[i].op != IrPhi) continue;
+        if (n == max)
+        { max = max ? 2*max : 16;
+          dst = (int *) realloc(dst, max*sizeof(int));
+          src = (int *) realloc(src, max*sizeof(int));
+          if (dst == NULL || src == NULL) irNoMemory();
+        }
+        if (irInstr[i].dst != irInstr[i].args[j])
+        { dst[n] = irInstr[i].dst;
+          src[n++] = irInstr[i].args[j];
+        }
+      }
+      sequence(dst, src, n, &first, &last);
+      if (first >= 0) irInsertCopies(t->pred[j], first);
+    }
+    for (i=t->first;i>=0;i=irInstr[i].next)
+      if (irInstr[i].op == IrPhi) irInstr[i].op = IrNop;
+  }
+  free(dst);
+  free(src);
+  irSweep();
+}
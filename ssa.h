@@ -0,0 +1,21 @@
+/****************************************************/
+/* File: ssa.h                                      */
+/* Static single assignment form of the IR code     */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _SSA_H_
+#define _SSA_H_
+
+/* Procedure toSSA puts the IR code in SSA form:
+ * every variable assignment gets a value of its
+ * own, and phis merge them where control joins
+ */
+void toSSA( void );
+
+/* Procedure fromSSA replaces the phis by copies at
+ * the end of the predecessors of their blocks
+ */
+void fromSSA( void );
+
+#endif
@@ -0,0 +1,87 @@
+/****************************************************/
+/* File: symbench.c                                 */
+/* Symbol table benchmark for the TINY compiler:    */
+/* times inserts, references and lookups of 10^3 to */
+/* 10^6 distinct names                              */
+/****************************************************/
+
+#include "globals.h"
+#include "arena.h"
+#include "intern.h"
+#include "symtab.h"
+#include <time.h>
+
+/* the globals of main.c that the symbol table uses */
+int lineno = 0;
+FILE * listing;
+
+/* OPS is the least number of operations timed
+ * for each size; small tables are run again
+ * until they reach it
+ */
+#define OPS 1000000L
+
+static int * atoms = NULL;
+
+/* Function opsPerSec returns the rate of n
+ * operations that took the clock ticks t
+ */
+static double opsPerSec( long n, clock_t t )
+{ double secs = (double) t / CLOCKS_PER_SEC;
+  return secs > 0 ? n / secs : 0;
+}
+
+/* Procedure bench fills the symbol table with n
+ * names and prints the rates of inserting them,
+ * adding a line reference to each and looking
+ * them up
+ */
+static void bench( int n )
+{ long rounds = (OPS + n - 1) / n, r;
+  clock_t tInsert = 0, tRef = 0, tLookup = 0, start;
+  int i, loc;
+  for (r=0;r<rounds;++r)
+  { st_reset();
+    internReset();
+    arenaReset();
+    for (i=0;i<n;++i)
+    { char name[16];
+      int len = sprintf(name,"v%d",i);
+      atoms[i] = internName(name,len);
+    }
+    loc = 0;
+    start = clock();
+    for (i=0;i<n;++i) st_insert(atoms[i],1,&loc);
+    tInsert += clock() - start;
+    start = clock();
+    for (i=0;i<n;++i) st_insert(atoms[i],2,&loc);
+    tRef += clock() - start;
+    start = clock();
+    for (i=0;i<n;++i)
+      if (st_lookup(atoms[(int)(i * 7919L % n)]) == NULL)
+      { fprintf(stderr,"symbol v%d lost\n",i);
+        exit(1);
+      }
+    tLookup += clock() - start;
+  }
+  printf("%8d %12.0f %12.0f %12.0f\n",n,
+         opsPerSec(rounds * n,tInsert),
+         opsPerSec(rounds * n,tRef),
+         opsPerSec(rounds * n,tLookup));
+}
+
+int main( void )
+{ int n;
+  listing = stdout;
+  atoms = (int *) malloc(1000000 * sizeof(int));
+  if (atoms == NULL)
+  { fprintf(stderr,"Out of memory\n");
+    exit(1);
+  }
+  printf("operations per second\n");
+  printf("%8s %12s %12s %12s\n","symbols","insert","reference","lookup");
+  for (n=1000;n<=1000000;n*=10) bench(n);
+  free(atoms);
+  arenaFree();
+  return 0;
+}
@@ -1,122 +1,292 @@
 /****************************************************/
 /* File: symtab.c                                   */
 /* Symbol table implementation for the TINY compiler*/
-/* (allows only one symbol table)                   */
-/* Symbol table is implemented as a chained         */
-/* hash table                                       */
+/* (one table with nested scopes)                   */
+/* Symbol table is implemented as an open-addressing*/
+/* hash table keyed by the atoms of intern.h, that  */
+/* doubles when half full. Each entry heads a chain */
+/* of bindings, innermost first; bindings of closed */
+/* scopes are skipped lazily on lookup              */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
 /****************************************************/
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+#include "globals.h"
+#include "arena.h"
+#include "intern.h"
 #include "symtab.h"
 
-/* SIZE is the size of the hash table */
-#define SIZE 211
+/* INITSIZE is the initial size of the hash table;
+   the size is always a power of two */
+#define INITSIZE 256
 
-/* SHIFT is the power of two used as multiplier
-   in hash function  */
-#define SHIFT 4
+/* the hash function: Fibonacci hashing spreads
+   consecutive atoms over the whole table */
+#define hash(atom) (((unsigned)(atom) * 2654435769u) >> hashShift)
 
-/* the hash function */
-static int hash ( char * key )
-{ int temp = 0;
-  int i = 0;
-  while (key[i] != '\0')
-  { temp = ((temp << SHIFT) + key[i]) % SIZE;
-    ++i;
+/* the line numbers of the source code in which
+ * the symbols are referenced: one vector for
+ * all symbols, where the references of each
+ * symbol are chained by index
+ */
+typedef struct LineRec
+   { int lineno;
+     int next; /* index of the next reference, or -1 */
+   } Line;
+
+static Line * lines = NULL;
+static int nlines = 0, maxlines = 0;
+
+/* the bindings in order of declaration; first
+ * and last of each index its line numbers
+ */
+static Symbol ** symbols = NULL;
+static int nsymbols = 0, maxsymbols = 0;
+
+/* The scopes in order of creation; scope 0 is
+ * the global scope. A scope is live from
+ * st_enterScope until its st_exitScope
+ */
+typedef struct ScopeRec
+   { int owner;  /* atom of the function, or 0 */
+     int parent;
+     int live;
+   } Scope;
+
+static Scope * scopes = NULL;
+static int nscopes = 0, maxscopes = 0;
+static int curScope = -1;
+
+/* the hash table: each slot holds an atom (0 if
+ * empty) and its innermost binding, or NULL
+ */
+typedef struct EntryRec
+   { int atom;
+     Symbol * head;
+   } Entry;
+
+static Entry * hashTable = NULL;
+static unsigned tableSize = 0, nentries = 0;
+static int hashShift = 32;
+
+static void noMemory(void)
+{ fprintf(listing,"Out of memory error in symbol table\n");
+  exit(1);
+}
+
+/* Procedure newScope appends a live scope nested
+ * in the current one and makes it current
+ */
+static void newScope( int owner )
+{ if (nscopes == maxscopes)
+  { maxscopes = maxscopes ? 2*maxscopes : 16;
+    scopes = (Scope *) realloc(scopes, maxscopes*sizeof(Scope));
+    if (scopes == NULL) noMemory();
   }
-  return temp;
+  scopes[nscopes].owner = owner;
+  scopes[nscopes].parent = curScope;
+  scopes[nscopes].live = 1;
+  curScope = nscopes++;
 }
 
-/* the list of line numbers of the source 
- * code in which a variable is referenced
+/* Procedure rehash makes the hash table size
+ * slots large and reinserts every entry
  */
-typedef struct LineListRec
-   { int lineno;
-     struct LineListRec * next;
-   } * LineList;
-
-/* The record in the bucket lists for
- * each variable, including name, 
- * assigned memory location, and
- * the list of line numbers in which
- * it appears in the source code
- */
-typedef struct BucketListRec
-   { char * name;
-     LineList lines;
-     int memloc ; /* memory location for variable */
-     struct BucketListRec * next;
-   } * BucketList;
-
-/* the hash table */
-static BucketList hashTable[SIZE];
-
-/* Procedure st_insert inserts line numbers and
- * memory locations into the symbol table
- * loc = memory location is inserted only the
- * first time, otherwise ignored
- */
-void st_insert( char * name, int lineno, int loc )
-{ int h = hash(name);
-  BucketList l =  hashTable[h];
-  while ((l != NULL) && (strcmp(name,l->name) != 0))
-    l = l->next;
-  if (l == NULL) /* variable not yet in table */
-  { l = (BucketList) malloc(sizeof(struct BucketListRec));
-    l->name = name;
-    l->lines = (LineList) malloc(sizeof(struct LineListRec));
-    l->lines->lineno = lineno;
-    l->memloc = loc;
-    l->lines->next = NULL;
-    l->next = hashTable[h];
-    hashTable[h] = l; }
-  else /* found in table, so just add line number */
-  { LineList t = l->lines;
-    while (t->next != NULL) t = t->next;
-    t->next = (LineList) malloc(sizeof(struct LineListRec));
-    t->next->lineno = lineno;
-    t->next->next = NULL;
+static void rehash( unsigned size )
+{ Entry * old = hashTable;
+  unsigned oldSize = tableSize, i;
+  hashTable = (Entry *) calloc(size, sizeof(Entry));
+  if (hashTable == NULL) noMemory();
+  tableSize = size;
+  hashShift = 32;
+  while (size > 1) { size >>= 1; hashShift--; }
+  for (i=0;i<oldSize;++i)
+    if (old[i].atom != 0)
+    { unsigned h = hash(old[i].atom);
+      while (hashTable[h].atom != 0) h = (h+1) & (tableSize-1);
+      hashTable[h] = old[i];
+    }
+  free(old);
+}
+
+/* Function find returns the entry of atom in
+ * the hash table, adding an empty one if the
+ * atom is not there yet
+ */
+static Entry * find( int atom )
+{ unsigned h;
+  if (2*(nentries+1) > tableSize)
+    rehash(tableSize ? 2*tableSize : INITSIZE);
+  h = hash(atom);
+  while (hashTable[h].atom != 0 && hashTable[h].atom != atom)
+    h = (h+1) & (tableSize-1);
+  if (hashTable[h].atom == 0)
+  { nentries++;
+    hashTable[h].atom = atom;
+    hashTable[h].head = NULL;
+  }
+  return &hashTable[h];
+}
+
+/* Function visible returns the innermost live
+ * binding of entry e, or NULL; bindings of closed
+ * scopes are unlinked on the way
+ */
+static Symbol * visible( Entry * e )
+{ while (e->head != NULL && !scopes[e->head->scope].live)
+    e->head = e->head->shadow;
+  return e->head;
+}
+
+/* Procedure addLine appends lineno to the line
+ * numbers of symbol s
+ */
+static void addLine( Symbol * s, int lineno )
+{ if (nlines == maxlines)
+  { maxlines = maxlines ? 2*maxlines : 4*INITSIZE;
+    lines = (Line *) realloc(lines, maxlines*sizeof(Line));
+    if (lines == NULL) noMemory();
+  }
+  lines[nlines].lineno = lineno;
+  lines[nlines].next = -1;
+  if (s->first < 0) s->first = nlines;
+  else lines[s->last].next = nlines;
+  s->last = nlines++;
+}
+
+/* Function bind adds a binding of e->atom in
+ * scope, hiding the visible one, and returns it
+ */
+static Symbol * bind( Entry * e, int scope, SymKind kind,
+                      ExpType type, int loc, int size )
+{ Symbol * s = (Symbol *) arenaAlloc(sizeof(Symbol));
+  if (s == NULL) noMemory();
+  if (nsymbols == maxsymbols)
+  { maxsymbols = maxsymbols ? 2*maxsymbols : INITSIZE;
+    symbols = (Symbol **) realloc(symbols, maxsymbols*sizeof(Symbol *));
+    if (symbols == NULL) noMemory();
   }
+  symbols[nsymbols++] = s;
+  s->atom = e->atom;
+  s->kind = kind;
+  s->type = type;
+  s->scope = scope;
+  s->memloc = loc;
+  s->size = size;
+  s->decl = NULL;
+  s->shadow = e->head;
+  s->first = s->last = -1;
+  e->head = s;
+  return s;
+}
+
+/* Procedure st_enterScope opens a scope nested
+ * in the current one; owner is the atom of the
+ * function it belongs to (0 for none)
+ */
+void st_enterScope( int owner )
+{ if (curScope < 0) newScope(0);
+  newScope(owner);
+}
+
+/* Procedure st_exitScope closes the current
+ * scope in O(1): its symbols stay in the table
+ * for the listing but are no longer visible
+ */
+void st_exitScope( void )
+{ if (curScope > 0)
+  { scopes[curScope].live = 0;
+    curScope = scopes[curScope].parent;
+  }
+}
+
+/* Function st_declare binds atom in the current
+ * scope with memory location (or frame offset)
+ * loc and size words; returns the new symbol,
+ * or NULL if atom is already declared in this
+ * scope. Line numbers are added by st_insert
+ */
+Symbol * st_declare( int atom, SymKind kind, ExpType type,
+                     int loc, int size )
+{ Entry * e = find(atom);
+  Symbol * s = visible(e);
+  if (curScope < 0) newScope(0);
+  if (s != NULL && s->scope == curScope) return NULL;
+  return bind(e, curScope, kind, type, loc, size);
+}
+
+/* Function st_insert inserts line numbers and
+ * memory locations into the symbol table
+ * the line number goes to the innermost visible
+ * symbol; if there is none, an integer variable
+ * is declared in the global scope at location
+ * *loc, and *loc is advanced. Returns the symbol
+ */
+Symbol * st_insert( int atom, int lineno, int * loc )
+{ Entry * e = find(atom);
+  Symbol * s = visible(e);
+  if (curScope < 0) newScope(0);
+  if (s == NULL) /* variable not yet in table */
+    s = bind(e, 0, VarSym, Integer, (*loc)++, 1);
+  addLine(s, lineno);
+  return s;
 } /* st_insert */
 
-/* Function st_lookup returns the memory 
- * location of a variable or -1 if not found
+/* Function st_lookup returns the innermost
+ * visible symbol atom or NULL if not found
  */
-int st_lookup ( char * name )
-{ int h = hash(name);
-  BucketList l =  hashTable[h];
-  while ((l != NULL) && (strcmp(name,l->name) != 0))
-    l = l->next;
-  if (l == NULL) return -1;
-  else return l->memloc;
+Symbol * st_lookup ( int atom )
+{ return visible(find(atom));
 }
 
-/* Procedure printSymTab prints a formatted 
- * listing of the symbol table contents 
- * to the listing file
+/* Procedure printSymTab prints a formatted
+ * listing of the symbol table contents
+ * to the listing file, one table per scope
  */
 void printSymTab(FILE * listing)
-{ int i;
-  fprintf(listing,"Variable Name  Location   Line Numbers\n");
-  fprintf(listing,"-------------  --------   ------------\n");
-  for (i=0;i<SIZE;++i)
-  { if (hashTable[i] != NULL)
-    { BucketList l = hashTable[i];
-      while (l != NULL)
-      { LineList t = l->lines;
-        fprintf(listing,"%-14s ",l->name);
-        fprintf(listing,"%-8d  ",l->memloc);
-        while (t != NULL)
-        { fprintf(listing,"%4d ",t->lineno);
-          t = t->next;
-        }
-        fprintf(listing,"\n");
-        l = l->next;
-      }
+{ static char * kindName[] = { "var", "array", "param", "func" };
+  int sc, i, j, k;
+  /* sort the bindings by scope: start[sc] is the
+     first entry of scope sc in order */
+  int * start = (int *) calloc(nscopes+1, sizeof(int));
+  int * order = (int *) malloc((nsymbols+1)*sizeof(int));
+  if (start == NULL || order == NULL) noMemory();
+  for (i=0;i<nsymbols;++i) start[symbols[i]->scope+1]++;
+  for (sc=0;sc<nscopes;++sc) start[sc+1] += start[sc];
+  for (i=0;i<nsymbols;++i) order[start[symbols[i]->scope]++] = i;
+  for (sc=nscopes;sc>0;--sc) start[sc] = start[sc-1];
+  start[0] = 0;
+  for (sc=0;sc<nscopes;++sc)
+  { if (sc > 0)
+    { if (scopes[sc].owner != 0)
+        fprintf(listing,"\nScope of %s:\n\n",atomName(scopes[sc].owner));
+      else
+        fprintf(listing,"\nScope %d:\n\n",sc);
+    }
+    fprintf(listing,"Variable Name  Kind   Type     Location   Line Numbers\n");
+    fprintf(listing,"-------------  -----  -------  --------   ------------\n");
+    for (k=start[sc];k<start[sc+1];++k)
+    { Symbol * s = symbols[order[k]];
+      fprintf(listing,"%-14s ",atomName(s->atom));
+      fprintf(listing,"%-6s ",kindName[s->kind]);
+      fprintf(listing,"%-8s ",typeString[s->type]);
+      fprintf(listing,"%-8d  ",s->memloc);
+      for (j=s->first;j>=0;j=lines[j].next)
+        fprintf(listing,"%4d ",lines[j].lineno);
+      fprintf(listing,"\n");
     }
   }
+  free(order);
+  free(start);
 } /* printSymTab */
+
+/* Procedure st_reset empties the symbol table for
+ * the next compilation unit; the hash table and
+ * vectors keep their size
+ */
+void st_reset( void )
+{ if (hashTable != NULL) memset(hashTable, 0, tableSize*sizeof(Entry));
+  nentries = 0;
+  nlines = nsymbols = nscopes = 0;
+  curScope = -1;
+}
@@ -1,7 +1,7 @@
 /****************************************************/
 /* File: symtab.h                                   */
 /* Symbol table interface for the TINY compiler     */
-/* (allows only one symbol table)                   */
+/* (one table with nested scopes)                   */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
 /****************************************************/
@@ -9,22 +9,80 @@
 #ifndef _SYMTAB_H_
 #define _SYMTAB_H_
 
-/* Procedure st_insert inserts line numbers and
+/* Symbols are named by their atoms (intern.h) */
+
+/* SymKind is the kind of a symbol */
+typedef enum { VarSym, ArraySym, ParamSym, FuncSym } SymKind;
+
+/* The record of each binding of a name; it lives
+ * in the arena, so tree nodes may point to it
+ */
+typedef struct SymbolRec
+   { int atom;
+     SymKind kind;
+     ExpType type;  /* of the variable, element or result */
+     int scope;     /* 0 = global */
+     int memloc;    /* memory location or frame offset
+                       (code location, for functions) */
+     int size;      /* words of memory (of the frame) */
+     TreeNode * decl; /* declaring node (FuncK for functions) */
+     struct SymbolRec * shadow; /* binding it hides */
+     int first, last; /* line numbers, inside symtab.c */
+   } Symbol;
+
+/* Layout of a function frame, addressed from the
+ * frame pointer upward: offset 0 holds the return
+ * address and 1 the caller's frame pointer; the
+ * parameters follow in order, then the locals.
+ * The size of a function symbol counts all of it
+ */
+#define FRAMEHDR 2
+
+/* Procedure st_enterScope opens a scope nested
+ * in the current one; owner is the atom of the
+ * function it belongs to (0 for none)
+ */
+void st_enterScope( int owner );
+
+/* Procedure st_exitScope closes the current
+ * scope in O(1): its symbols stay in the table
+ * for the listing but are no longer visible
+ */
+void st_exitScope( void );
+
+/* Function st_declare binds atom in the current
+ * scope with memory location (or frame offset)
+ * loc and size words; returns the new symbol,
+ * or NULL if atom is already declared in this
+ * scope. Line numbers are added by st_insert
+ */
+Symbol * st_declare( int atom, SymKind kind, ExpType type,
+                     int loc, int size );
+
+/* Function st_insert inserts line numbers and
  * memory locations into the symbol table
- * loc = memory location is inserted only the
- * first time, otherwise ignored
+ * the line number goes to the innermost visible
+ * symbol; if there is none, an integer variable
+ * is declared in the global scope at location
+ * *loc, and *loc is advanced. Returns the symbol
  */
-void st_insert( char * name, int lineno, int loc );
+Symbol * st_insert( int atom, int lineno, int * loc );
 
-/* Function st_lookup returns the memory 
- * location of a variable or -1 if not found
+/* Function st_lookup returns the innermost
+ * visible symbol atom or NULL if not found
  */
-int st_lookup ( char * name );
+Symbol * st_lookup ( int atom );
 
-/* Procedure printSymTab prints a formatted 
- * listing of the symbol table contents 
+/* Procedure printSymTab prints a formatted
+ * listing of the symbol table contents
  * to the listing file
  */
 void printSymTab(FILE * listing);
 
+/* Procedure st_reset empties the symbol table for
+ * the next compilation unit; it goes with
+ * arenaReset, which releases the symbols
+ */
+void st_reset( void );
+
 #endif
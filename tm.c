@@ -0,0 +1,534 @@
+/****************************************************/
+/* File: tm.c                                       */
+/* The TM ("Tiny Machine") computer                 */
+/* The code file (text, or binary as in tmobj.h) is */
+/* decoded once into an array of instructions,      */
+/* which is then run by a threaded interpreter      */
+/* (computed goto where the compiler has it, a      */
+/* switch elsewhere)                                */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+#include "tmobj.h"
+
+/* HAVE_MMAP selects memory-mapped loading of
+ * binary code files
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP 1
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define HAVE_MMAP 0
+#endif
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+/* THREADED selects computed-goto dispatch */
+#if defined(__GNUC__) && !defined(NO_THREADED)
+#define THREADED 1
+#else
+#define THREADED 0
+#endif
+
+/******* const *******/
+#define DADDR_SIZE 65536 /* words of data memory */
+#define NO_REGS 8
+#define PC_REG 7
+
+#define LINESIZE 121
+#define WORDSIZE 20
+
+/******* type *******/
+
+typedef enum
+{
+    srOKAY,
+    srHALT,
+    srIMEM_ERR,
+    srDMEM_ERR,
+    srZERODIVIDE,
+    srOVERFLOW,
+    srIN_ERR
+} StepResult;
+
+/* A decoded instruction: RR instructions use r,s,t,
+ * RM and RA instructions use r,d(s); handler is the
+ * address of its code in the threaded interpreter
+ */
+typedef struct
+{
+    int op;
+    int r, s, t;
+#if THREADED
+    const void* handler;
+#endif
+} Instruction;
+
+/******** vars ********/
+static Instruction* iMem = NULL;
+static int iSize = 0; /* instructions in iMem */
+static int dMem[DADDR_SIZE];
+static int reg[NO_REGS];
+
+static char* stepResultTab[] =
+{
+    "OK","Halted","Instruction Memory Fault",
+    "Data Memory Fault","Division by 0","Division overflow","Bad input"
+};
+
+static char* fileName;
+static int lineNo;
+
+/* toFloat and fromFloat convert between a word
+ * and the float whose bits it holds
+ */
+static float toFloat(int w)
+{
+    float f;
+    memcpy(&f, &w, sizeof(f));
+    return f;
+}
+
+static int fromFloat(float f)
+{
+    int w;
+    memcpy(&w, &f, sizeof(w));
+    return w;
+}
+
+/********************************************/
+static int error(char* msg, int loc)
+{
+    if (lineNo > 0) fprintf(stderr, "%s(%d): %s", fileName, lineNo, msg);
+    else fprintf(stderr, "%s: %s", fileName, msg);
+    if (loc >= 0) fprintf(stderr, " at location %d", loc);
+    fprintf(stderr, "\n");
+    return FALSE;
+}
+
+/* growMem makes room for instruction loc, filling
+ * new locations with HALT
+ */
+static int growMem(int loc)
+{
+    int size = iSize ? iSize : 1024;
+    Instruction* p;
+    while (size <= loc) size *= 2;
+    p = (Instruction*)realloc(iMem, size * sizeof(Instruction));
+    if (p == NULL) return error("Out of memory", loc);
+    memset(p + iSize, 0, (size - iSize) * sizeof(Instruction));
+    iMem = p;
+    iSize = size;
+    return TRUE;
+}
+
+/* getNum reads a signed number at *p, skipping blanks */
+static int getNum(char** p, int* num)
+{
+    char* end;
+    while (**p == ' ' || **p == '\t') (*p)++;
+    *num = (int)strtol(*p, &end, 10);
+    if (end == *p) return FALSE;
+    *p = end;
+    return TRUE;
+}
+
+/* skipChar skips blanks and then character c */
+static int skipChar(char** p, int c)
+{
+    while (**p == ' ' || **p == '\t') (*p)++;
+    if (**p != c) return FALSE;
+    (*p)++;
+    return TRUE;
+}
+
+/* getReg reads a register number */
+static int getReg(char** p, int* r)
+{
+    return getNum(p, r) && *r >= 0 && *r < NO_REGS;
+}
+
+/* Function readInstructions decodes the .tm file
+ * into iMem; comment lines start with '*'
+ */
+static int readInstructions(FILE* pgm)
+{
+    char line[LINESIZE];
+    char word[WORDSIZE];
+    int loc, op, n, d;
+    char* p;
+    if (!growMem(0)) return FALSE;
+    lineNo = 0;
+    while (fgets(line, LINESIZE, pgm) != NULL)
+    {
+        size_t len = strlen(line);
+        lineNo++;
+        /* drop the rest of an overlong line (a comment) */
+        if (len > 0 && line[len - 1] != '\n')
+        {
+            int ch;
+            while ((ch = getc(pgm)) != EOF && ch != '\n');
+        }
+        p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '*' || *p == '\n' || *p == '\0') continue;
+        if (!getNum(&p, &loc) || loc < 0)
+            return error("Bad location", -1);
+        if (!skipChar(&p, ':'))
+            return error("Missing colon", loc);
+        while (*p == ' ' || *p == '\t') p++;
+        for (n = 0; n < WORDSIZE - 1 && isalpha((unsigned char)*p); n++)
+            word[n] = *p++;
+        word[n] = '\0';
+        for (op = opHALT; op < opRALim; op++)
+            if (strcmp(tmOpName[op], word) == 0) break;
+        if (op >= opRALim || op == opRRLim || op == opRMLim)
+            return error("Illegal opcode", loc);
+        if (loc >= iSize && !growMem(loc)) return FALSE;
+        iMem[loc].op = op;
+        if (op < opRRLim)
+        {
+            if (!getReg(&p, &iMem[loc].r) || !skipChar(&p, ',')
+                || !getReg(&p, &iMem[loc].s) || !skipChar(&p, ',')
+                || !getReg(&p, &iMem[loc].t))
+                return error("Bad register", loc);
+        }
+        else
+        {
+            if (!getReg(&p, &iMem[loc].r) || !skipChar(&p, ','))
+                return error("Bad first register", loc);
+            if (!getNum(&p, &d) || !skipChar(&p, '('))
+                return error("Bad displacement", loc);
+            if (!getReg(&p, &iMem[loc].s) || !skipChar(&p, ')'))
+                return error("Bad second register", loc);
+            iMem[loc].t = d;
+        }
+    }
+    return TRUE;
+}
+
+/* Function loadObject decodes the size bytes of
+ * a binary code file at base into iMem
+ */
+static int loadObject(const char* base, size_t size)
+{
+    TmHeader h;
+    const TmWord* w;
+    int loc;
+    lineNo = 0;
+    if (size < sizeof(TmHeader))
+        return error("Truncated code file", -1);
+    memcpy(&h, base, sizeof(TmHeader));
+    if (h.version != TMOBJ_VERSION)
+        return error("Unknown code file version", -1);
+    if (h.size < 0 || (size - sizeof(TmHeader)) / sizeof(TmWord) < (size_t)h.size)
+        return error("Truncated code file", -1);
+    if (!growMem(h.size)) return FALSE;
+    w = (const TmWord*)(base + sizeof(TmHeader));
+    for (loc = 0; loc < h.size; loc++, w++)
+    {
+        int op = w->op;
+        if (op >= opRALim || op == opRRLim || op == opRMLim)
+            return error("Illegal opcode", loc);
+        if (w->r >= NO_REGS || w->s >= NO_REGS || w->t >= NO_REGS)
+            return error("Bad register", loc);
+        iMem[loc].op = op;
+        iMem[loc].r = w->r;
+        iMem[loc].s = w->s;
+        iMem[loc].t = op < opRRLim ? w->t : w->d;
+    }
+    return TRUE;
+}
+
+/* Function readObject maps the binary code file
+ * name into memory (or reads it where mmap is
+ * missing) and decodes it
+ */
+static int readObject(char* name)
+{
+#if HAVE_MMAP
+    struct stat st;
+    void* base;
+    int ok, fd = open(name, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0)
+        return error("Cannot read code file", -1);
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return error("Cannot map code file", -1);
+    ok = loadObject((const char*)base, (size_t)st.st_size);
+    munmap(base, (size_t)st.st_size);
+    return ok;
+#else
+    FILE* f = fopen(name, "rb");
+    long size;
+    char* buf;
+    int ok;
+    if (f == NULL) return error("Cannot read code file", -1);
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+    buf = (char*)malloc(size > 0 ? size : 1);
+    if (buf == NULL) return error("Out of memory", -1);
+    ok = fread(buf, 1, size, f) == (size_t)size
+        && loadObject(buf, (size_t)size);
+    free(buf);
+    fclose(f);
+    return ok;
+#endif
+}
+
+/* Function run executes the program from location 0
+ * until it halts or faults; *count gets the number
+ * of instructions executed and *loc the location
+ * of the last one. RM and RA instructions keep
+ * their displacement in t. Called with count NULL,
+ * run only sets up the instructions for dispatch
+ */
+static StepResult run(long* count, int* loc)
+{
+    register Instruction* ip = NULL;
+    register int pc = 0;
+    register long n = 0;
+    int m;
+    float f, g;
+    StepResult result = srOKAY;
+
+/* the address d(s) of an RM or RA instruction,
+   wrapping around like the arithmetic */
+#define EA ((int)((unsigned)ip->t + (unsigned)reg[ip->s]))
+
+#if THREADED
+    static const void* labels[] =
+    {
+        &&lHALT, &&lIN, &&lOUT, &&lADD, &&lSUB, &&lMUL, &&lDIV,
+        &&lINF, &&lOUTF, &&lADDF, &&lSUBF, &&lMULF, &&lDIVF, &&lCMPF,
+        &&lITOF, &&lFTOI, &&lHALT,
+        &&lLD, &&lST, &&lHALT,
+        &&lLDA, &&lLDC, &&lJLT, &&lJLE, &&lJGT, &&lJGE, &&lJEQ, &&lJNE, &&lHALT
+    };
+    int i;
+    if (count == NULL)
+    {
+        for (i = 0; i < iSize; i++)
+            iMem[i].handler = labels[iMem[i].op];
+        return srOKAY;
+    }
+/* fetch the instruction at reg(7) and jump to its code */
+#define NEXT \
+    if ((unsigned)(pc = reg[PC_REG]) >= (unsigned)iSize) goto imemErr; \
+    ip = &iMem[pc]; reg[PC_REG] = pc + 1; n++; \
+    goto *ip->handler
+#define CASE(x) l##x:
+#define DISPATCH NEXT;
+#else
+    if (count == NULL) return srOKAY;
+#define NEXT continue
+#define CASE(x) case op##x:
+#define DISPATCH \
+    for (;;) { \
+        if ((unsigned)(pc = reg[PC_REG]) >= (unsigned)iSize) goto imemErr; \
+        ip = &iMem[pc]; reg[PC_REG] = pc + 1; n++; \
+        switch (ip->op) {
+#define END_DISPATCH default: goto halt; } }
+#endif
+
+    DISPATCH
+    CASE(HALT)
+        goto halt;
+    CASE(IN)
+        if (scanf("%d", &reg[ip->r]) != 1)
+        {
+            result = srIN_ERR;
+            goto done;
+        }
+        NEXT;
+    CASE(OUT)
+        printf("OUT instruction prints: %d\n", reg[ip->r]);
+        NEXT;
+    /* integer arithmetic wraps around: it is done
+       in unsigned, where overflow is defined */
+    CASE(ADD)
+        reg[ip->r] = (int)((unsigned)reg[ip->s] + (unsigned)reg[ip->t]);
+        NEXT;
+    CASE(SUB)
+        reg[ip->r] = (int)((unsigned)reg[ip->s] - (unsigned)reg[ip->t]);
+        NEXT;
+    CASE(MUL)
+        reg[ip->r] = (int)((unsigned)reg[ip->s] * (unsigned)reg[ip->t]);
+        NEXT;
+    CASE(DIV)
+        if (reg[ip->t] == 0)
+        {
+            result = srZERODIVIDE;
+            goto done;
+        }
+        /* the one quotient that does not fit a word */
+        if (reg[ip->t] == -1 && reg[ip->s] == INT_MIN)
+        {
+            result = srOVERFLOW;
+            goto done;
+        }
+        reg[ip->r] = reg[ip->s] / reg[ip->t];
+        NEXT;
+    CASE(INF)
+        if (scanf("%f", &f) != 1)
+        {
+            result = srIN_ERR;
+            goto done;
+        }
+        reg[ip->r] = fromFloat(f);
+        NEXT;
+    CASE(OUTF)
+        printf("OUT instruction prints: %g\n", toFloat(reg[ip->r]));
+        NEXT;
+    CASE(ADDF)
+        reg[ip->r] = fromFloat(toFloat(reg[ip->s]) + toFloat(reg[ip->t]));
+        NEXT;
+    CASE(SUBF)
+        reg[ip->r] = fromFloat(toFloat(reg[ip->s]) - toFloat(reg[ip->t]));
+        NEXT;
+    CASE(MULF)
+        reg[ip->r] = fromFloat(toFloat(reg[ip->s]) * toFloat(reg[ip->t]));
+        NEXT;
+    CASE(DIVF)
+        /* as in IEEE arithmetic, dividing by 0
+           gives an infinity (or NaN), not a fault */
+        reg[ip->r] = fromFloat(toFloat(reg[ip->s]) / toFloat(reg[ip->t]));
+        NEXT;
+    CASE(CMPF)
+        f = toFloat(reg[ip->s]);
+        g = toFloat(reg[ip->t]);
+        reg[ip->r] = f < g ? -1 : (f > g ? 1 : 0);
+        NEXT;
+    CASE(ITOF)
+        reg[ip->r] = fromFloat((float)reg[ip->s]);
+        NEXT;
+    CASE(FTOI)
+        reg[ip->r] = (int)toFloat(reg[ip->s]);
+        NEXT;
+    CASE(LD)
+        m = EA;
+        if ((unsigned)m >= DADDR_SIZE) goto dmemErr;
+        reg[ip->r] = dMem[m];
+        NEXT;
+    CASE(ST)
+        m = EA;
+        if ((unsigned)m >= DADDR_SIZE) goto dmemErr;
+        dMem[m] = reg[ip->r];
+        NEXT;
+    CASE(LDA)
+        reg[ip->r] = EA;
+        NEXT;
+    CASE(LDC)
+        reg[ip->r] = ip->t;
+        NEXT;
+    CASE(JLT)
+        if (reg[ip->r] < 0) reg[PC_REG] = EA;
+        NEXT;
+    CASE(JLE)
+        if (reg[ip->r] <= 0) reg[PC_REG] = EA;
+        NEXT;
+    CASE(JGT)
+        if (reg[ip->r] > 0) reg[PC_REG] = EA;
+        NEXT;
+    CASE(JGE)
+        if (reg[ip->r] >= 0) reg[PC_REG] = EA;
+        NEXT;
+    CASE(JEQ)
+        if (reg[ip->r] == 0) reg[PC_REG] = EA;
+        NEXT;
+    CASE(JNE)
+        if (reg[ip->r] != 0) reg[PC_REG] = EA;
+        NEXT;
+#if !THREADED
+    END_DISPATCH
+#endif
+
+halt:
+    result = srHALT;
+    goto done;
+imemErr:
+    result = srIMEM_ERR;
+    goto done;
+dmemErr:
+    result = srDMEM_ERR;
+done:
+    *count = n;
+    *loc = pc;
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* pgm;
+    unsigned int magic = 0;
+    int ok;
+    char pgmName[FILENAME_MAX];
+    StepResult result;
+    long count;
+    int loc;
+    clock_t start;
+    double secs;
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <filename>\n", argv[0]);
+        exit(1);
+    }
+    strncpy(pgmName, argv[1], FILENAME_MAX - 4);
+    pgmName[FILENAME_MAX - 4] = '\0';
+    if (strchr(pgmName, '.') == NULL)
+        strcat(pgmName, ".tm");
+    pgm = fopen(pgmName, "rb");
+    if (pgm == NULL)
+    {
+        fprintf(stderr, "file '%s' not found\n", pgmName);
+        exit(1);
+    }
+    fileName = pgmName;
+    /* binary code files are known by their magic number */
+    if (fread(&magic, sizeof(magic), 1, pgm) != 1) magic = 0;
+    fclose(pgm);
+    if (magic == TMOBJ_MAGIC)
+        ok = readObject(pgmName);
+    else
+    {
+        pgm = fopen(pgmName, "r");
+        ok = pgm != NULL && readInstructions(pgm);
+        if (pgm != NULL) fclose(pgm);
+    }
+    if (!ok)
+        exit(1);
+
+    /* the machine starts with the top of memory in
+       location 0 and everything else cleared */
+    dMem[0] = DADDR_SIZE - 1;
+
+    run(NULL, NULL);
+    start = clock();
+    result = run(&count, &loc);
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    fflush(stdout);
+    if (result != srHALT)
+        fprintf(stderr, "%s at location %d\n",
+            stepResultTab[result], loc);
+    fprintf(stderr, "%ld instructions executed in %.3f s", count, secs);
+    if (secs > 0)
+        fprintf(stderr, " (%.0f instructions/sec)", count / secs);
+    fprintf(stderr, "\n");
+    return result == srHALT ? 0 : 1;
+}
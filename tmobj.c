@@ -0,0 +1,18 @@
+/****************************************************/
+/* File: tmobj.c                                    */
+/* The TM opcode names, shared by the code emitter  */
+/* and the TM machine                               */
+/****************************************************/
+
+#include "tmobj.h"
+
+/* the names of the opcodes in the text format */
+char* tmOpName[] =
+{
+    "HALT","IN","OUT","ADD","SUB","MUL","DIV",
+    "INF","OUTF","ADDF","SUBF","MULF","DIVF","CMPF","ITOF","FTOI","????",
+    /* RR opcodes */
+    "LD","ST","????", /* RM opcodes */
+    "LDA","LDC","JLT","JLE","JGT","JGE","JEQ","JNE","????"
+    /* RA opcodes */
+};
@@ -0,0 +1,95 @@
+/****************************************************/
+/* File: tmobj.h                                    */
+/* TM opcodes and the binary TM object format,      */
+/* shared by the code emitter and the TM machine    */
+/****************************************************/
+
+#ifndef _TMOBJ_H_
+#define _TMOBJ_H_
+
+/* Registers and memory words hold integers; the
+ * float instructions take them as the bits of
+ * IEEE single precision floats
+ */
+typedef enum
+{
+    /* RR instructions */
+    opHALT, /* RR     halt, operands are ignored */
+    opIN,   /* RR     read into reg(r); s and t are ignored */
+    opOUT,  /* RR     write from reg(r), s and t are ignored */
+    opADD,  /* RR     reg(r) = reg(s)+reg(t) */
+    opSUB,  /* RR     reg(r) = reg(s)-reg(t) */
+    opMUL,  /* RR     reg(r) = reg(s)*reg(t) */
+    opDIV,  /* RR     reg(r) = reg(s)/reg(t) */
+    opINF,  /* RR     read float into reg(r); s and t are ignored */
+    opOUTF, /* RR     write float from reg(r), s and t are ignored */
+    opADDF, /* RR     reg(r) = reg(s)+reg(t), as floats */
+    opSUBF, /* RR     reg(r) = reg(s)-reg(t), as floats */
+    opMULF, /* RR     reg(r) = reg(s)*reg(t), as floats */
+    opDIVF, /* RR     reg(r) = reg(s)/reg(t), as floats */
+    opCMPF, /* RR     reg(r) = -1, 0 or 1 as float reg(s) <, = or > reg(t) */
+    opITOF, /* RR     reg(r) = float of integer reg(s); t is ignored */
+    opFTOI, /* RR     reg(r) = integer of float reg(s), truncated */
+    opRRLim, /* limit of RR opcodes */
+
+    /* RM instructions */
+    opLD,   /* RM     reg(r) = mem(d+reg(s)) */
+    opST,   /* RM     mem(d+reg(s)) = reg(r) */
+    opRMLim, /* Limit of RM opcodes */
+
+    /* RA instructions */
+    opLDA,  /* RA     reg(r) = d+reg(s) */
+    opLDC,  /* RA     reg(r) = d ; reg(s) is ignored */
+    opJLT,  /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
+    opJLE,  /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
+    opJGT,  /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
+    opJGE,  /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
+    opJEQ,  /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
+    opJNE,  /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
+    opRALim /* Limit of RA opcodes */
+} TmOp;
+
+/* the names of the opcodes in the text format,
+ * indexed by TmOp (in tmobj.c)
+ */
+extern char* tmOpName[];
+
+/* A binary object file holds a header, then one
+ * TmWord per location 0..size-1, then ncomments
+ * comment records, each followed by its len
+ * characters padded to a multiple of 4. Numbers
+ * are in the byte order of the machine that wrote
+ * the file, which the magic number tells
+ */
+#define TMOBJ_MAGIC 0x424F4D54 /* "TMOB" on little-endian machines */
+#define TMOBJ_VERSION 2
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+    int size;      /* instructions */
+    int ncomments; /* comment records */
+} TmHeader;
+
+/* An instruction: RR instructions use r,s,t,
+ * RM and RA instructions use r,d(s)
+ */
+typedef struct
+{
+    unsigned char op, r, s, t;
+    int d;
+} TmWord;
+
+/* A comment: kind 0 is a comment line before
+ * location loc, kind 1 the comment of the
+ * instruction at loc
+ */
+typedef struct
+{
+    int loc;
+    int kind;
+    int len;
+} TmComment;
+
+#endif
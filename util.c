@@ -8,6 +8,7 @@
 
 #include "globals.h"
 #include "util.h"
+#include "arena.h"
 
 /*  token ӡ嵥ļ */
 void printToken(TokenType token, const char* tokenString)
@@ -50,11 +51,12 @@ void printToken(TokenType token, const char* tokenString)
 }
 
 /* Function newStmtNode creates a new statement
- * node for syntax tree construction
+ * node for syntax tree construction; nodes are
+ * owned by the arena of the compilation unit
  */
 TreeNode* newStmtNode(StmtKind kind)
 {
-    TreeNode* t = (TreeNode*)malloc(sizeof(TreeNode));
+    TreeNode* t = (TreeNode*)arenaAlloc(sizeof(TreeNode));
     int i;
     if (t == NULL)
         fprintf(listing, "Out of memory error at line %d\n", lineno);
@@ -74,7 +76,7 @@ TreeNode* newStmtNode(StmtKind kind)
  */
 TreeNode* newExpNode(ExpKind kind)
 {
-    TreeNode* t = (TreeNode*)malloc(sizeof(TreeNode));
+    TreeNode* t = (TreeNode*)arenaAlloc(sizeof(TreeNode));
     int i;
     if (t == NULL)
         fprintf(listing, "Out of memory error at line %d\n", lineno);
@@ -91,13 +93,13 @@ TreeNode* newExpNode(ExpKind kind)
 }
 
 /* Function copyString allocates and makes a new
- * copy of an existing string
+ * copy of an existing string in the arena
  */
 char* copyString(char* src)
 {
     if (src == NULL) return NULL;
     int n = strlen(src) + 1;
-    char* dst = (char*)malloc(n * sizeof(char));
+    char* dst = (char*)arenaAlloc(n * sizeof(char));
     if (dst == NULL)
         fprintf(listing, "Out of memory error at line %d\n", lineno);
     //else strcpy(dst, src);
@@ -121,85 +123,182 @@ static void printSpaces(void)
         fprintf(listing, " ");
 }
 
-/* procedure printTree prints a syntax tree to the 
- * listing file using indentation to indicate subtrees
+/* procedure printNode prints the line of a single
+ * syntax tree node (without indentation) to the
+ * listing file
  */
-void printTree(TreeNode* tree)
+static void printNode(TreeNode* tree)
 {
-    int i;
-    INDENT;
-    while (tree != NULL) {
-        printSpaces();
-        switch (tree->nodekind)
-        {
-        case StmtK:
-            switch (tree->kind.stmt) {
-            case IfK:
-                fprintf(listing, "If\n");
-                break;
-            case RepeatK:
-                fprintf(listing, "Repeat\n");
-                break;
-            case AssignK:
-                fprintf(listing, "Assign to: %s\n", tree->attr.name);
-                break;
-            case ReadK:
-                fprintf(listing, "Read: %s\n", tree->attr.name);
-                break;
-            case WriteK:
-                fprintf(listing, "Write\n");
-                break;
-            case WhileK:
-                fprintf(listing, "While\n");
-                break;
-            case DeclareK:
-                fprintf(listing, "Declare: %s\n", typeString[tree->type]);
-                break;
-            case FuncK:
-                fprintf(listing, "Function: %s -> %s\n", tree->attr.name, typeString[tree->type]);
-                break;
-            case ReturnK:
-                fprintf(listing, "Return:\n");
-                break;
-            default:
-                fprintf(listing, "Unknown StmtNode kind\n");
-                break;
-            }
-            break;
-        case ExpK:
-            switch (tree->kind.exp) {
-            case OpK:
-                fprintf(listing, "Op: ");
-                printToken(tree->attr.op, "\0");
-                break;
-            case ConstK:
-                if (tree->type == Float) fprintf(listing, "Const: %f\n", tree->attr.fval);
-                else fprintf(listing, "Const: %d\n", tree->attr.val);
-                break;
-            case IdK:
-                if(tree->attr.val == 0) fprintf(listing, "Id: %s\n", tree->attr.name);
-                else fprintf(listing, "Array: %s[%d]\n", tree->attr.name, tree->attr.val);
-                break;
-            case ArrayK:
-                fprintf(listing, "Array: %s\n", tree->attr.name);
-                break;
-            case ParamK:
-                fprintf(listing, "Param: %s -> %s\n", tree->attr.name, typeString[tree->type]);
-                break;
-            case CallK:
-                fprintf(listing, "Call: %s\n", tree->attr.name);
-                break;
-            default:
-                fprintf(listing, "Unknown ExpNode kind\n");
-                break;
-            }
+    switch (tree->nodekind)
+    {
+    case StmtK:
+        switch (tree->kind.stmt) {
+        case IfK:
+            fprintf(listing, "If\n");
+            break;
+        case RepeatK:
+            fprintf(listing, "Repeat\n");
+            break;
+        case AssignK:
+            fprintf(listing, "Assign to: %s\n", tree->attr.name);
+            break;
+        case ReadK:
+            fprintf(listing, "Read: %s\n", tree->attr.name);
+            break;
+        case WriteK:
+            fprintf(listing, "Write\n");
+            break;
+        case WhileK:
+            fprintf(listing, "While\n");
+            break;
+        case DeclareK:
+            fprintf(listing, "Declare: %s\n", typeString[tree->type]);
+            break;
+        case FuncK:
+            fprintf(listing, "Function: %s -> %s\n", tree->attr.name, typeString[tree->type]);
+            break;
+        case ReturnK:
+            fprintf(listing, "Return:\n");
             break;
         default:
-            fprintf(listing, "Unknown node kind\n");
+            fprintf(listing, "Unknown StmtNode kind\n");
+            break;
         }
-        for (i = 0; i < MAXCHILDREN; i++)
-            printTree(tree->child[i]);
-        tree = tree->sibling;
+        break;
+    case ExpK:
+        switch (tree->kind.exp) {
+        case OpK:
+            fprintf(listing, "Op: ");
+            printToken(tree->attr.op, "\0");
+            break;
+        case ConstK:
+            if (tree->type == Float) fprintf(listing, "Const: %f\n", tree->attr.fval);
+            else fprintf(listing, "Const: %d\n", tree->attr.val);
+            break;
+        case IdK:
+            if(tree->attr.val == 0) fprintf(listing, "Id: %s\n", tree->attr.name);
+            else fprintf(listing, "Array: %s[%d]\n", tree->attr.name, tree->attr.val);
+            break;
+        case ArrayK:
+            fprintf(listing, "Array: %s\n", tree->attr.name);
+            break;
+        case ParamK:
+            fprintf(listing, "Param: %s -> %s\n", tree->attr.name, typeString[tree->type]);
+            break;
+        case CallK:
+            fprintf(listing, "Call: %s\n", tree->attr.name);
+            break;
+        case ConvK:
+            fprintf(listing, "Convert to: %s\n", typeString[tree->type]);
+            break;
+        default:
+            fprintf(listing, "Unknown ExpNode kind\n");
+            break;
+        }
+        break;
+    default:
+        fprintf(listing, "Unknown node kind\n");
     }
+}
+
+/* the frames of walkTree: each walks a sibling list,
+ * t is the current node of the list and phase the
+ * next phase to visit it with
+ */
+typedef struct
+{
+    TreeNode* t;
+    int phase;
+} WalkFrame;
+
+static WalkFrame* walkStack = NULL;
+static int walkTop = 0, walkCap = 0;
+
+/* the descent requested by the current visit */
+static int walkDescend = FALSE;
+static TreeNode* walkNext = NULL;
+
+static void walkPush(TreeNode* t)
+{
+    if (walkTop == walkCap)
+    {
+        walkCap = walkCap ? walkCap * 2 : 256;
+        walkStack = (WalkFrame*)realloc(walkStack, walkCap * sizeof(WalkFrame));
+        if (walkStack == NULL)
+        {
+            fprintf(listing, "Out of memory error traversing syntax tree\n");
+            exit(1);
+        }
+    }
+    walkStack[walkTop].t = t;
+    walkStack[walkTop].phase = 0;
+    walkTop++;
+}
+
+/* Procedure walkList asks walkTree to walk the sibling
+ * list t (which may be NULL) before visiting the
+ * current node again
+ */
+void walkList(TreeNode* t)
+{
+    walkDescend = TRUE;
+    walkNext = t;
+}
+
+/* Procedure walkTree walks the syntax tree t and its
+ * siblings without recursion. Each node is visited
+ * with phase 0, 1, ... for as long as the visit calls
+ * walkList; then the walk moves on to its sibling
+ */
+void walkTree(TreeNode* t, WalkProc visit)
+{
+    int base = walkTop;
+    /* walks may nest inside a visit */
+    int savedDescend = walkDescend;
+    TreeNode* savedNext = walkNext;
+    if (t != NULL) walkPush(t);
+    while (walkTop > base)
+    {
+        TreeNode* n = walkStack[walkTop - 1].t;
+        walkDescend = FALSE;
+        visit(n, walkStack[walkTop - 1].phase++);
+        if (walkDescend)
+        {
+            if (walkNext != NULL) walkPush(walkNext);
+        }
+        else if (n->sibling != NULL)
+        {
+            /* the frame of a list is reused for the sibling */
+            walkStack[walkTop - 1].t = n->sibling;
+            walkStack[walkTop - 1].phase = 0;
+        }
+        else walkTop--;
+    }
+    walkDescend = savedDescend;
+    walkNext = savedNext;
+}
+
+/* printVisit prints node t and its children,
+ * indented two more spaces
+ */
+static void printVisit(TreeNode* t, int phase)
+{
+    if (phase == 0)
+    {
+        printSpaces();
+        printNode(t);
+        INDENT;
+    }
+    if (phase < MAXCHILDREN) walkList(t->child[phase]);
+    else UNINDENT;
+}
+
+/* procedure printTree prints a syntax tree to the 
+ * listing file using indentation to indicate subtrees
+ */
+void printTree(TreeNode* tree)
+{
+    INDENT;
+    walkTree(tree, printVisit);
     UNINDENT;
 }
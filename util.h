@@ -28,6 +28,25 @@ TreeNode * newExpNode(ExpKind);
  */
 char * copyString( char * );
 
+/* WalkProc is the type of the visit procedures of
+ * walkTree: it is called with a node and the phase
+ * of the visit, 0 the first time
+ */
+typedef void (*WalkProc)( TreeNode *, int );
+
+/* Procedure walkTree walks the syntax tree t and its
+ * siblings without recursion. Each node is visited
+ * with phase 0, 1, ... for as long as the visit calls
+ * walkList; then the walk moves on to its sibling
+ */
+void walkTree( TreeNode *, WalkProc );
+
+/* Procedure walkList asks walkTree to walk the sibling
+ * list t (which may be NULL) before visiting the
+ * current node again
+ */
+void walkList( TreeNode * );
+
 /* procedure printTree prints a syntax tree to the 
  * listing file using indentation to indicate subtrees
  */
@@ -0,0 +1,411 @@
+/****************************************************/
+/* File: x86code.c                                  */
+/* x86-64 code emitting utilities implementation    */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#include "globals.h"
+#include "x86code.h"
+
+/* HAVE_MMAP selects the mapping of machine code
+ * into executable memory, as in tm.c, on x86-64
+ */
+#if (defined(__unix__) || defined(__APPLE__)) && defined(__x86_64__)
+#define HAVE_MMAP 1
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define HAVE_MMAP 0
+#endif
+
+/* the name of each instruction, and the size of
+ * its source and destination registers: b, l, q
+ * or x (xmm)
+ */
+static struct { char * name; char s, d; } info[] =
+   { { "cltd",0,0 }, { "ret",0,0 }, { "leave",0,0 }, { "rep stosl",0,0 },
+     { "pushq",'q',0 }, { "popq",'q',0 }, { "idivl",'l',0 },
+     { "sete",'b',0 }, { "call",'q',0 },
+     { "movl",'l','l' }, { "movq",'q','q' }, { "addl",'l','l' },
+     { "subl",'l','l' }, { "imull",'l','l' }, { "cmpl",'l','l' },
+     { "testl",'l','l' }, { "xorl",'l','l' },
+     { "shrl",'l','l' }, { "andl",'l','l' }, { "addq",'q','q' },
+     { "subq",'q','q' }, { "andq",'q','q' },
+     { "movzbl",'b','l' }, { "movslq",'l','q' },
+     { "movd",'l','x' }, { "movd",'x','l' },
+     { "addss",'x','x' }, { "subss",'x','x' }, { "mulss",'x','x' },
+     { "divss",'x','x' }, { "cmpltss",'x','x' }, { "cmpeqss",'x','x' },
+     { "cvtsi2ss",'l','x' }, { "cvttss2si",'x','l' },
+     { "leaq",0,'q' },
+     { "je",0,0 }, { "jne",0,0 }, { "jmp",0,0 }, { "call",0,0 } };
+
+static char * names64[] =
+   { "rax","rcx","rdx","rbx","rsp","rbp","rsi","rdi",
+     "r8","r9","r10","r11","r12","r13","r14","r15" };
+static char * names32[] =
+   { "eax","ecx","edx","ebx","esp","ebp","esi","edi",
+     "r8d","r9d","r10d","r11d","r12d","r13d","r14d","r15d" };
+static char * names8[] = { "al","cl","dl","bl" };
+
+/* TRUE if the code is text */
+static int text = TRUE;
+
+/* the machine code */
+static unsigned char * buf = NULL;
+static int nbuf = 0, maxbuf = 0;
+
+/* the location of each label (-1 until placed)
+ * and its name, or NULL
+ */
+static int * labelLoc = NULL;
+static char ** labelName = NULL;
+static int nlabels = 0, maxlabels = 0;
+
+/* The 32-bit fields still to be patched: the
+ * offset of a label, or (for label -1) of the
+ * global word at byte disp
+ */
+typedef struct
+   { int loc;
+     int label;
+     int disp;
+   } Fixup;
+
+static Fixup * fixups = NULL;
+static int nfixups = 0, maxfixups = 0;
+
+/* the memory the code was mapped to */
+static void * mapped = NULL;
+static size_t mapSize = 0;
+
+static void noMemory(void)
+{ fprintf(listing,"Out of memory error generating code\n");
+  exit(1);
+}
+
+static void byte( int b )
+{ if (nbuf == maxbuf)
+  { maxbuf = maxbuf ? 2*maxbuf : 4096;
+    buf = (unsigned char *) realloc(buf, maxbuf);
+    if (buf == NULL) noMemory();
+  }
+  buf[nbuf++] = (unsigned char) b;
+}
+
+static void word32( int w )
+{ unsigned int u = (unsigned int) w;
+  byte(u & 0xFF);
+  byte((u >> 8) & 0xFF);
+  byte((u >> 16) & 0xFF);
+  byte(u >> 24);
+}
+
+static void addFixup( int label, int disp )
+{ if (nfixups == maxfixups)
+  { maxfixups = maxfixups ? 2*maxfixups : 256;
+    fixups = (Fixup *) realloc(fixups, maxfixups*sizeof(Fixup));
+    if (fixups == NULL) noMemory();
+  }
+  fixups[nfixups].loc = nbuf;
+  fixups[nfixups].label = label;
+  fixups[nfixups++].disp = disp;
+  word32(0);
+}
+
+/* Function regName returns the name of register
+ * r at size size
+ */
+static char * regName( int r, char size )
+{ static char xmm[2][8];
+  static int k = 0;
+  switch (size)
+  { case 'b': return names8[r];
+    case 'l': return names32[r];
+    case 'x':
+      k = !k;
+      sprintf(xmm[k],"xmm%d",r);
+      return xmm[k];
+    default:  return names64[r];
+  }
+}
+
+static char * labelText( int label )
+{ static char s[16];
+  if (labelName[label] != NULL) return labelName[label];
+  sprintf(s,".L%d",label);
+  return s;
+}
+
+/* Procedure rex emits the REX prefix of a 64-bit
+ * operation (w) or of registers from r8 on
+ */
+static void rex( int w, int reg, int index, int base )
+{ int r = 0x40 | w << 3 | (reg & 8) >> 1 | (index & 8) >> 2 | (base & 8) >> 3;
+  if (r != 0x40) byte(r);
+}
+
+/* Procedure opcode emits op, after 0x0F if it is
+ * above 0xFF
+ */
+static void opcode( int op )
+{ if (op > 0xFF) byte(op >> 8);
+  byte(op & 0xFF);
+}
+
+/* Procedure encode emits an instruction on the
+ * registers reg and rm of its ModRM byte, after
+ * prefix (if not 0) and the REX prefix
+ */
+static void encode( int prefix, int w, int op, int reg, int rm )
+{ if (prefix) byte(prefix);
+  rex(w,reg,0,rm);
+  opcode(op);
+  byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+/* Procedure encodeMem emits an instruction on
+ * register reg and a memory word
+ */
+static void encodeMem( int w, int op, int reg, int base, int index, int disp )
+{ rex(w,reg,index < 0 ? 0 : index,base == RIP ? 0 : base);
+  opcode(op);
+  if (base == RIP)
+  { byte(0x05 | (reg & 7) << 3);
+    addFixup(-1,disp);
+  }
+  else if (index < 0)
+  { byte(0x80 | (reg & 7) << 3 | (base & 7));
+    if ((base & 7) == RSP) byte(0x24);
+    word32(disp);
+  }
+  else
+  { byte(0x84 | (reg & 7) << 3);
+    byte(0x80 | (index & 7) << 3 | (base & 7));
+    word32(disp);
+  }
+}
+
+static char * memText( int base, int index, int disp )
+{ static char s[40];
+  if (base == RIP)
+  { if (disp == 0) sprintf(s,"tinymem(%%rip)");
+    else sprintf(s,"tinymem+%d(%%rip)",disp);
+  }
+  else if (index < 0) sprintf(s,"%d(%%%s)",disp,names64[base]);
+  else sprintf(s,"%d(%%%s,%%%s,4)",disp,names64[base],names64[index]);
+  return s;
+}
+
+void xBegin( int asText )
+{ text = asText;
+  nbuf = nlabels = nfixups = 0;
+}
+
+int xNewLabel( char * name )
+{ if (nlabels == maxlabels)
+  { maxlabels = maxlabels ? 2*maxlabels : 256;
+    labelLoc = (int *) realloc(labelLoc, maxlabels*sizeof(int));
+    labelName = (char **) realloc(labelName, maxlabels*sizeof(char *));
+    if (labelLoc == NULL || labelName == NULL) noMemory();
+  }
+  labelLoc[nlabels] = -1;
+  labelName[nlabels] = NULL;
+  if (name != NULL)
+  { labelName[nlabels] = (char *) malloc(strlen(name)+1);
+    if (labelName[nlabels] == NULL) noMemory();
+    strcpy(labelName[nlabels],name);
+  }
+  return nlabels++;
+}
+
+void xLabel( int label )
+{ if (text) fprintf(code,"%s:\n",labelText(label));
+  else labelLoc[label] = nbuf;
+}
+
+void xOp( XOp op )
+{ if (text)
+  { fprintf(code,"\t%s\n",info[op].name);
+    return;
+  }
+  switch (op)
+  { case X_CLTD:     byte(0x99); break;
+    case X_RET:      byte(0xC3); break;
+    case X_LEAVE:    byte(0xC9); break;
+    case X_REPSTOSL: byte(0xF3); byte(0xAB); break;
+    default:         break;
+  }
+}
+
+void xR( XOp op, int r )
+{ if (text)
+  { fprintf(code,"\t%s\t%s%%%s\n",info[op].name,
+            op == X_CALLR ? "*" : "",regName(r,info[op].s));
+    return;
+  }
+  switch (op)
+  { case X_PUSHQ: rex(0,0,0,r); byte(0x50 + (r & 7)); break;
+    case X_POPQ:  rex(0,0,0,r); byte(0x58 + (r & 7)); break;
+    case X_IDIVL: encode(0,0,0xF7,7,r); break;
+    case X_SETE:  encode(0,0,0x0F94,0,r); break;
+    case X_CALLR: encode(0,0,0xFF,2,r); break;
+    default:      break;
+  }
+}
+
+void xRR( XOp op, int s, int d )
+{ if (text)
+  { fprintf(code,"\t%s\t%%%s, %%%s\n",info[op].name,
+            regName(s,info[op].s),regName(d,info[op].d));
+    return;
+  }
+  switch (op)
+  { case X_MOVL:       encode(0,0,0x89,s,d); break;
+    case X_MOVQ:       encode(0,1,0x89,s,d); break;
+    case X_ADDL:       encode(0,0,0x01,s,d); break;
+    case X_SUBL:       encode(0,0,0x29,s,d); break;
+    case X_CMPL:       encode(0,0,0x39,s,d); break;
+    case X_TESTL:      encode(0,0,0x85,s,d); break;
+    case X_XORL:       encode(0,0,0x31,s,d); break;
+    case X_IMULL:      encode(0,0,0x0FAF,d,s); break;
+    case X_MOVZBL:     encode(0,0,0x0FB6,d,s); break;
+    case X_MOVSLQ:     encode(0,1,0x63,d,s); break;
+    case X_MOVD_TOX:   encode(0x66,0,0x0F6E,d,s); break;
+    case X_MOVD_FROMX: encode(0x66,0,0x0F7E,s,d); break;
+    case X_ADDSS:      encode(0xF3,0,0x0F58,d,s); break;
+    case X_SUBSS:      encode(0xF3,0,0x0F5C,d,s); break;
+    case X_MULSS:      encode(0xF3,0,0x0F59,d,s); break;
+    case X_DIVSS:      encode(0xF3,0,0x0F5E,d,s); break;
+    case X_CMPLTSS:    encode(0xF3,0,0x0FC2,d,s); byte(1); break;
+    case X_CMPEQSS:    encode(0xF3,0,0x0FC2,d,s); byte(0); break;
+    case X_CVTSI2SS:   encode(0xF3,0,0x0F2A,d,s); break;
+    case X_CVTTSS2SI:  encode(0xF3,0,0x0F2C,d,s); break;
+    default:           break;
+  }
+}
+
+void xIR( XOp op, int i, int d )
+{ int w = 0, ext = 0;
+  if (text)
+  { fprintf(code,"\t%s\t$%d, %%%s\n",info[op].name,i,regName(d,info[op].d));
+    return;
+  }
+  switch (op)
+  { case X_MOVL:
+      rex(0,0,0,d);
+      byte(0xB8 + (d & 7));
+      word32(i);
+      return;
+    case X_SHRL:
+      encode(0,0,0xC1,5,d);
+      byte(i);
+      return;
+    case X_ANDL: ext = 4; break;
+    case X_CMPL: ext = 7; break;
+    case X_ADDQ: w = 1; ext = 0; break;
+    case X_SUBQ: w = 1; ext = 5; break;
+    case X_ANDQ: w = 1; ext = 4; break;
+    default:     return;
+  }
+  if (i >= -128 && i <= 127)
+  { encode(0,w,0x83,ext,d);
+    byte(i);
+  }
+  else
+  { encode(0,w,0x81,ext,d);
+    word32(i);
+  }
+}
+
+void xLoad( XOp op, int base, int index, int disp, int r )
+{ if (text)
+    fprintf(code,"\t%s\t%s, %%%s\n",info[op].name,
+            memText(base,index,disp),regName(r,info[op].d));
+  else if (op == X_LEAQ) encodeMem(1,0x8D,r,base,index,disp);
+  else encodeMem(0,0x8B,r,base,index,disp);
+}
+
+void xStore( XOp op, int r, int base, int index, int disp )
+{ if (text)
+    fprintf(code,"\t%s\t%%%s, %s\n",info[op].name,
+            regName(r,info[op].s),memText(base,index,disp));
+  else encodeMem(0,0x89,r,base,index,disp);
+}
+
+void xJump( XOp op, int label )
+{ if (text)
+  { fprintf(code,"\t%s\t%s\n",info[op].name,labelText(label));
+    return;
+  }
+  switch (op)
+  { case X_JE:   byte(0x0F); byte(0x84); break;
+    case X_JNE:  byte(0x0F); byte(0x85); break;
+    case X_JMP:  byte(0xE9); break;
+    case X_CALL: byte(0xE8); break;
+    default:     break;
+  }
+  addFixup(label,0);
+}
+
+void xCallC( void (* fn)(void) )
+{ unsigned char a[sizeof fn];
+  int k;
+  memcpy(a,&fn,sizeof fn);
+  /* movabs $fn, %rax; call *%rax */
+  byte(0x48);
+  byte(0xB8);
+  for (k = 0; k < 8; k++) byte(k < (int) sizeof fn ? a[k] : 0);
+  xR(X_CALLR,RAX);
+}
+
+void xText( char * s )
+{ if (text) fprintf(code,"%s\n",s);
+}
+
+int xIsText( void )
+{ return text;
+}
+
+void * xMap( int label, int words )
+{
+#if HAVE_MMAP
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t codeSize = ((size_t) nbuf + page-1) / page * page;
+  int k;
+  /* the offsets are relative to the end of the
+     field; the global words follow the code */
+  for (k = 0; k < nfixups; k++)
+  { Fixup * f = &fixups[k];
+    int to = (f->label < 0) ? (int) codeSize + f->disp : labelLoc[f->label];
+    unsigned int u = (unsigned int) (to - (f->loc + 4));
+    buf[f->loc] = u & 0xFF;
+    buf[f->loc+1] = (u >> 8) & 0xFF;
+    buf[f->loc+2] = (u >> 16) & 0xFF;
+    buf[f->loc+3] = u >> 24;
+  }
+  mapSize = codeSize + ((size_t) 4*words + page-1) / page * page;
+  mapped = mmap(NULL,mapSize,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANON,-1,0);
+  if (mapped == MAP_FAILED)
+  { mapped = NULL;
+    return NULL;
+  }
+  memcpy(mapped,buf,nbuf);
+  if (mprotect(mapped,codeSize,PROT_READ|PROT_EXEC) != 0) return NULL;
+  return (char *) mapped + labelLoc[label];
+#else
+  return NULL;
+#endif
+}
+
+void xEnd( void )
+{ int k;
+#if HAVE_MMAP
+  if (mapped != NULL) munmap(mapped,mapSize);
+#endif
+  mapped = NULL;
+  for (k = 0; k < nlabels; k++) free(labelName[k]);
+  free(buf); free(labelLoc); free(labelName); free(fixups);
+  buf = NULL; labelLoc = NULL; labelName = NULL; fixups = NULL;
+  nbuf = maxbuf = nlabels = maxlabels = nfixups = maxfixups = 0;
+}
@@ -0,0 +1,121 @@
+/****************************************************/
+/* File: x86code.h                                  */
+/* x86-64 code emitting utilities for the TINY      */
+/* compiler: each instruction is written either as  */
+/* GNU as text or as machine code in memory         */
+/****************************************************/
+
+#ifndef _X86CODE_H_
+#define _X86CODE_H_
+
+/* registers, numbered as the machine encodes them;
+ * xmm registers are numbered from 0 as well, the
+ * instruction tells them apart
+ */
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSP 4
+#define RBP 5
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define R14 14
+#define R15 15
+#define XMM0 0
+#define XMM1 1
+
+/* RIP as a base addresses the global words, which
+ * follow the code; NOREG stands for no index
+ */
+#define RIP 16
+#define NOREG -1
+
+/* The instructions, with the size of their
+ * operands as in their GNU as names
+ */
+typedef enum
+   { /* no operand */
+     X_CLTD, X_RET, X_LEAVE, X_REPSTOSL,
+     /* one register */
+     X_PUSHQ, X_POPQ, X_IDIVL, X_SETE, X_CALLR,
+     /* two registers (source, destination), or
+        an immediate and a register for the ALU
+        ones; MOVD_TOX moves to an xmm register,
+        MOVD_FROMX from one */
+     X_MOVL, X_MOVQ, X_ADDL, X_SUBL, X_IMULL, X_CMPL, X_TESTL, X_XORL,
+     X_SHRL, X_ANDL, X_ADDQ, X_SUBQ, X_ANDQ,
+     X_MOVZBL, X_MOVSLQ, X_MOVD_TOX, X_MOVD_FROMX,
+     X_ADDSS, X_SUBSS, X_MULSS, X_DIVSS, X_CMPLTSS, X_CMPEQSS,
+     X_CVTSI2SS, X_CVTTSS2SI,
+     /* memory (with X_MOVL) */
+     X_LEAQ,
+     /* to a label */
+     X_JE, X_JNE, X_JMP, X_CALL
+   } XOp;
+
+/* Procedure xBegin starts the code, as text to
+ * the code file if text is TRUE, else as machine
+ * code in memory
+ */
+void xBegin( int text );
+
+/* Function xNewLabel returns a new label, named
+ * name in the text (NULL for a local one)
+ */
+int xNewLabel( char * name );
+
+/* Procedure xLabel places label at the current
+ * location
+ */
+void xLabel( int label );
+
+/* Procedures xOp, xR, xRR, xIR emit instruction
+ * op on no operand, register r, registers s (the
+ * source) and d, or immediate i and register d
+ */
+void xOp( XOp op );
+void xR( XOp op, int r );
+void xRR( XOp op, int s, int d );
+void xIR( XOp op, int i, int d );
+
+/* Procedures xLoad and xStore emit op between
+ * register r and the memory word at disp from
+ * base, plus 4 times index unless it is NOREG
+ */
+void xLoad( XOp op, int base, int index, int disp, int r );
+void xStore( XOp op, int r, int base, int index, int disp );
+
+/* Procedure xJump emits jump (or call) op to
+ * label, patched once the label is placed
+ */
+void xJump( XOp op, int label );
+
+/* Procedure xCallC emits a call of C function fn
+ * through rax; machine code only
+ */
+void xCallC( void (* fn)(void) );
+
+/* Procedure xText writes line s to the code file
+ * as it is; text only
+ */
+void xText( char * s );
+
+/* Function xIsText is TRUE if the code is text */
+int xIsText( void );
+
+/* Function xMap puts the machine code, followed by
+ * words zeroed words of global memory, in memory
+ * it makes executable, and returns the address
+ * of label there; NULL if that is not possible
+ */
+void * xMap( int label, int words );
+
+/* Procedure xEnd frees the code (and its memory,
+ * for machine code)
+ */
+void xEnd( void );
+
+#endif
@@ -0,0 +1,660 @@
+/****************************************************/
+/* File: x86gen.c                                   */
+/* The x86-64 code generator for the TINY compiler  */
+/* (generates GNU as code for the System V ABI, or  */
+/* machine code run in memory)                      */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "x86code.h"
+#include "x86gen.h"
+#include <limits.h>
+#include <setjmp.h>
+
+/* Every value is 32 bits and is computed in %eax;
+ * a float is kept there as its bits, and moved to
+ * %xmm0 and %xmm1 for the operations on it.
+ *
+ * Globals are words of tinymem. A function frame
+ * is addressed from %rbp: the arguments are pushed
+ * by the caller above the return address, the
+ * callee-saved registers lie below it, then the
+ * locals at localBase, by their frame offsets
+ */
+
+/* bytes of the saved registers below %rbp */
+#define SAVED 40
+
+/* Registers tmpReg[] hold the left operands of
+ * binary operations while the right ones are
+ * evaluated (they are callee-saved, so they
+ * survive calls); deeper operands are pushed.
+ * tmpRegs counts the operands held, as in cgen.c
+ */
+#define NTMPREGS 5
+static int tmpReg[NTMPREGS] = { RBX, R12, R13, R14, R15 };
+static int tmpRegs = 0;
+
+/* the function being generated: its number of
+ * parameters, the offset of its locals from %rbp
+ * and the label of its return
+ */
+static int nparams = 0;
+static int localBase = 0;
+static int retLabel = 0;
+
+/* words of global memory, and of the frame of
+ * the function being measured
+ */
+static int globalWords = 0;
+static int frameWords = 0;
+
+/* the labels of the program, of the read and
+ * write procedures, and of the procedures that
+ * stop the program on a division that TM stops on
+ */
+static int mainLabel, readInt, readFloat, writeInt, writeFloat;
+static int divZero, divOverflow;
+
+/* The labels still to be placed by the statement
+ * being generated, a stack as in cgen.c
+ */
+static int * savedLabels = NULL;
+static int nsaved = 0, maxsaved = 0;
+
+static void pushLabel( int label )
+{ if (nsaved == maxsaved)
+  { maxsaved = maxsaved ? 2*maxsaved : 64;
+    savedLabels = (int *) realloc(savedLabels, maxsaved*sizeof(int));
+    if (savedLabels == NULL)
+    { fprintf(listing,"Out of memory error generating code\n");
+      exit(1);
+    }
+  }
+  savedLabels[nsaved++] = label;
+}
+
+static int popLabel( void )
+{ return savedLabels[--nsaved];
+}
+
+/* Procedure locate gives the base register and
+ * displacement of word index of variable s
+ */
+static void locate( Symbol * s, int index, int * base, int * disp )
+{ if (s->scope == 0)
+  { *base = RIP;
+    *disp = 4*(s->memloc+index);
+  }
+  else if (s->kind == ParamSym)
+  { *base = RBP;
+    *disp = 16+8*(nparams-1-(s->memloc-FRAMEHDR));
+  }
+  else
+  { *base = RBP;
+    *disp = localBase+4*(s->memloc+index);
+  }
+}
+
+static void loadVar( Symbol * s )
+{ int base, disp;
+  locate(s,0,&base,&disp);
+  xLoad(X_MOVL,base,NOREG,disp,RAX);
+}
+
+static void storeVar( Symbol * s )
+{ int base, disp;
+  locate(s,0,&base,&disp);
+  xStore(X_MOVL,RAX,base,NOREG,disp);
+}
+
+/* Procedure measure is the visit that finds the
+ * words of global memory and of the frame used
+ */
+static void measure( TreeNode * t, int phase)
+{ Symbol * s = t->sym;
+  if (phase == 0 && s != NULL && s->kind != FuncSym)
+  { int * words = (s->scope == 0) ? &globalWords : &frameWords;
+    if (s->memloc+s->size > *words) *words = s->memloc+s->size;
+  }
+  if (phase < MAXCHILDREN) walkList(t->child[phase]);
+}
+
+/* Function need returns the number of temporary
+ * registers the evaluation of expression t takes,
+ * kept by labelNode in attr.val as in cgen.c
+ */
+static int need( TreeNode * t)
+{ while (t != NULL && t->nodekind == ExpK && t->kind.exp == ConvK)
+    t = t->child[0];
+  if (t == NULL || t->nodekind != ExpK || t->kind.exp != OpK) return 0;
+  return t->attr.val;
+}
+
+static void labelNode( TreeNode * t, int phase)
+{ if (phase < MAXCHILDREN) walkList(t->child[phase]);
+  else if (t->nodekind == ExpK && t->kind.exp == OpK)
+  { int l = need(t->child[0]), r = need(t->child[1]);
+    t->attr.val = (l == r) ? l+1 : (l > r ? l : r);
+  }
+}
+
+static void genNode( TreeNode * tree, int phase);
+
+/* Procedure genStmt generates code at a statement
+ * node; phase counts the visits of walkTree, and
+ * walkList generates the code of a child
+ */
+static void genStmt( TreeNode * tree, int phase)
+{ int label;
+  switch (tree->kind.stmt) {
+    case IfK:
+      if (phase == 0) walkList(tree->child[0]);
+      else if (phase == 1)
+      { label = xNewLabel(NULL);
+        xRR(X_TESTL,RAX,RAX);
+        xJump(X_JE,label);
+        pushLabel(label);
+        walkList(tree->child[1]);
+      }
+      else if (phase == 2)
+      { int elseLabel = popLabel();
+        label = xNewLabel(NULL);
+        if (tree->child[2] != NULL) xJump(X_JMP,label);
+        xLabel(elseLabel);
+        pushLabel(label);
+        walkList(tree->child[2]);
+      }
+      else
+      { label = popLabel();
+        if (tree->child[2] != NULL) xLabel(label);
+      }
+      break;
+    case RepeatK:
+      if (phase == 0)
+      { label = xNewLabel(NULL);
+        xLabel(label);
+        pushLabel(label);
+        walkList(tree->child[0]);
+      }
+      else if (phase == 1) walkList(tree->child[1]);
+      else
+      { xRR(X_TESTL,RAX,RAX);
+        xJump(X_JE,popLabel());
+      }
+      break;
+    case WhileK:
+      if (phase == 0)
+      { label = xNewLabel(NULL);
+        xLabel(label);
+        pushLabel(label);
+        pushLabel(xNewLabel(NULL));
+        walkList(tree->child[0]);
+      }
+      else if (phase == 1)
+      { xRR(X_TESTL,RAX,RAX);
+        xJump(X_JE,savedLabels[nsaved-1]);
+        walkList(tree->child[1]);
+      }
+      else
+      { int exit = popLabel();
+        xJump(X_JMP,popLabel());
+        xLabel(exit);
+      }
+      break;
+    case AssignK:
+      if (phase == 0) walkList(tree->child[0]);
+      else storeVar(tree->sym);
+      break;
+    case ReadK:
+      xJump(X_CALL,tree->sym->type == Float ? readFloat : readInt);
+      storeVar(tree->sym);
+      break;
+    case WriteK:
+      if (phase == 0) walkList(tree->child[0]);
+      else
+      { xRR(X_MOVL,RAX,RDI);
+        xJump(X_CALL,tree->child[0]->type == Float ? writeFloat : writeInt);
+      }
+      break;
+    case ReturnK:
+      if (phase == 0) walkList(tree->child[0]);
+      else xJump(X_JMP,retLabel);
+      break;
+    default:
+      /* functions are generated after the program,
+         declarations take no code */
+      break;
+  }
+} /* genStmt */
+
+/* Procedure genOp combines the operands of op,
+ * the left one in %eax and the right one in %ecx
+ */
+static void genOp( TokenType op, ExpType type)
+{ if (type == Float)
+  { xRR(X_MOVD_TOX,RAX,XMM0);
+    xRR(X_MOVD_TOX,RCX,XMM1);
+    switch (op) {
+      case PLUS:  xRR(X_ADDSS,XMM1,XMM0); break;
+      case MINUS: xRR(X_SUBSS,XMM1,XMM0); break;
+      case TIMES: xRR(X_MULSS,XMM1,XMM0); break;
+      case DIV:   xRR(X_DIVSS,XMM1,XMM0); break;
+      case LT:    xRR(X_CMPLTSS,XMM1,XMM0); break;
+      case EQ:    xRR(X_CMPEQSS,XMM1,XMM0); break;
+      default:    break;
+    }
+    xRR(X_MOVD_FROMX,XMM0,RAX);
+    /* a comparison leaves a mask of ones */
+    if (op == LT || op == EQ) xIR(X_ANDL,1,RAX);
+    return;
+  }
+  switch (op) {
+    case PLUS:  xRR(X_ADDL,RCX,RAX); break;
+    case MINUS: xRR(X_SUBL,RCX,RAX); break;
+    case TIMES: xRR(X_IMULL,RCX,RAX); break;
+    case DIV:
+    { /* idivl faults on these two, TM stops on
+         them with a message */
+      int label = xNewLabel(NULL);
+      xRR(X_TESTL,RCX,RCX);
+      xJump(X_JE,divZero);
+      xIR(X_CMPL,-1,RCX);
+      xJump(X_JNE,label);
+      xIR(X_CMPL,INT_MIN,RAX);
+      xJump(X_JE,divOverflow);
+      xLabel(label);
+      xOp(X_CLTD);
+      xR(X_IDIVL,RCX);
+      break;
+    }
+    case LT:
+      /* the sign of the difference, as TM tests it */
+      xRR(X_SUBL,RCX,RAX);
+      xIR(X_SHRL,31,RAX);
+      break;
+    case EQ:
+      xRR(X_CMPL,RCX,RAX);
+      xR(X_SETE,RAX);
+      xRR(X_MOVZBL,RAX,RAX);
+      break;
+    default:
+      xText("# BUG: Unknown operator");
+      break;
+  }
+}
+
+/* Procedure genExp generates code at an expression
+ * node, in phases like genStmt
+ */
+static void genExp( TreeNode * tree, int phase)
+{ TreeNode * arg;
+  int n, base, disp;
+  switch (tree->kind.exp) {
+    case ConstK:
+      if (tree->type == Float)
+      { union { float f; int i; } bits;
+        bits.f = tree->attr.fval;
+        xIR(X_MOVL,bits.i,RAX);
+      }
+      else if (tree->attr.val == 0) xRR(X_XORL,RAX,RAX);
+      else xIR(X_MOVL,tree->attr.val,RAX);
+      break;
+    case IdK:
+      loadVar(tree->sym);
+      break;
+    case ArrayK:
+      if (phase == 0) walkList(tree->child[0]);
+      else
+      { xRR(X_MOVSLQ,RAX,RAX);
+        locate(tree->sym,0,&base,&disp);
+        if (base == RIP)
+        { /* no index with %rip */
+          xLoad(X_LEAQ,RIP,NOREG,0,RCX);
+          base = RCX;
+        }
+        xLoad(X_MOVL,base,RAX,disp,RAX);
+      }
+      break;
+    case OpK:
+    { /* the operand needing more registers goes first */
+      int rightFirst = need(tree->child[1]) > need(tree->child[0]);
+      if (phase == 0) walkList(tree->child[rightFirst]);
+      else if (phase == 1)
+      { /* hold the first operand */
+        if (++tmpRegs <= NTMPREGS)
+          xRR(X_MOVL,RAX,tmpReg[tmpRegs-1]);
+        else
+          xR(X_PUSHQ,RAX);
+        walkList(tree->child[!rightFirst]);
+      }
+      else
+      { /* left operand to %eax, right one to %ecx */
+        if (!rightFirst) xRR(X_MOVL,RAX,RCX);
+        if (tmpRegs > NTMPREGS)
+          xR(X_POPQ,rightFirst ? RCX : RAX);
+        else
+          xRR(X_MOVL,tmpReg[tmpRegs-1],rightFirst ? RCX : RAX);
+        tmpRegs--;
+        genOp(tree->attr.op,tree->child[0]->type);
+      }
+      break;
+    }
+    case ConvK:
+      if (phase == 0) walkList(tree->child[0]);
+      else if (tree->type == Float && tree->child[0]->type != Float)
+      { xRR(X_CVTSI2SS,RAX,XMM0);
+        xRR(X_MOVD_FROMX,XMM0,RAX);
+      }
+      else if (tree->type != Float && tree->child[0]->type == Float)
+      { xRR(X_MOVD_TOX,RAX,XMM0);
+        xRR(X_CVTTSS2SI,XMM0,RAX);
+      }
+      break;
+    case CallK:
+      /* push the arguments in order, each walked
+         on its own, then pop them after the call;
+         the function's label is in attr.val of
+         its FuncK node */
+      n = 0;
+      for (arg = tree->child[0]; arg != NULL; arg = arg->sibling)
+      { TreeNode * next = arg->sibling;
+        arg->sibling = NULL;
+        walkTree(arg,genNode);
+        arg->sibling = next;
+        xR(X_PUSHQ,RAX);
+        n++;
+      }
+      xJump(X_CALL,tree->sym->decl->attr.val);
+      if (n > 0) xIR(X_ADDQ,8*n,RSP);
+      break;
+    default:
+      break;
+  }
+} /* genExp */
+
+/* Procedure genNode is the visit procedure of
+ * the code generator's walk of the syntax tree
+ */
+static void genNode( TreeNode * tree, int phase)
+{ switch (tree->nodekind) {
+    case StmtK:
+      genStmt(tree,phase);
+      break;
+    case ExpK:
+      genExp(tree,phase);
+      break;
+    default:
+      break;
+  }
+}
+
+/* Procedure genBody generates the function (or
+ * program) at label name whose statements are
+ * body, with words of frame for its locals
+ */
+static void genBody( int name, TreeNode * body, int words)
+{ int bytes = (4*words+7) & ~7;
+  char s[80];
+  localBase = -SAVED-bytes;
+  retLabel = xNewLabel(NULL);
+  if (name == mainLabel)
+  { xText("");
+    xText("\t.globl\tmain");
+    xText("\t.type\tmain, @function");
+  }
+  else if (xIsText())
+  { sprintf(s,"\n# function with %d parameters",nparams);
+    xText(s);
+  }
+  xLabel(name);
+  xR(X_PUSHQ,RBP);
+  xRR(X_MOVQ,RSP,RBP);
+  xR(X_PUSHQ,RBX);
+  xR(X_PUSHQ,R12);
+  xR(X_PUSHQ,R13);
+  xR(X_PUSHQ,R14);
+  xR(X_PUSHQ,R15);
+  if (bytes > 0)
+  { /* the locals start out zero, like globals */
+    xIR(X_SUBQ,bytes,RSP);
+    xRR(X_MOVQ,RSP,RDI);
+    xIR(X_MOVL,bytes/4,RCX);
+    xRR(X_XORL,RAX,RAX);
+    xOp(X_REPSTOSL);
+  }
+  walkTree(body,genNode);
+  xRR(X_XORL,RAX,RAX);
+  xLabel(retLabel);
+  xLoad(X_LEAQ,RBP,NOREG,-SAVED,RSP);
+  xR(X_POPQ,R15);
+  xR(X_POPQ,R14);
+  xR(X_POPQ,R13);
+  xR(X_POPQ,R12);
+  xR(X_POPQ,RBX);
+  xR(X_POPQ,RBP);
+  xOp(X_RET);
+}
+
+/* Procedure genProgram generates the program as
+ * main, then each function
+ */
+static void genProgram( TreeNode * syntaxTree)
+{ TreeNode * t;
+  char name[80];
+  mainLabel = xNewLabel("main");
+  readInt = xNewLabel("rt_readi");
+  readFloat = xNewLabel("rt_readf");
+  writeInt = xNewLabel("rt_writei");
+  writeFloat = xNewLabel("rt_writef");
+  divZero = xNewLabel("rt_divzero");
+  divOverflow = xNewLabel("rt_divovf");
+  globalWords = 0;
+  walkTree(syntaxTree,measure);
+  walkTree(syntaxTree,labelNode);
+  for (t = syntaxTree; t != NULL; t = t->sibling)
+    if (t->nodekind == StmtK && t->kind.stmt == FuncK)
+    { sprintf(name,"fn_%.70s",t->attr.name);
+      t->attr.val = xNewLabel(name);
+    }
+  /* the statements of the program follow the
+     functions */
+  nparams = 0;
+  for (t = syntaxTree; t != NULL && t->nodekind == StmtK && t->kind.stmt == FuncK; )
+    t = t->sibling;
+  genBody(mainLabel,t,0);
+  for (t = syntaxTree; t != NULL; t = t->sibling)
+    if (t->nodekind == StmtK && t->kind.stmt == FuncK)
+    { TreeNode * p;
+      nparams = 0;
+      for (p = t->child[0]; p != NULL; p = p->sibling) nparams++;
+      frameWords = 0;
+      walkTree(t->child[0],measure);
+      walkTree(t->child[1],measure);
+      genBody(t->attr.val,t->child[1],frameWords);
+    }
+  free(savedLabels);
+  savedLabels = NULL;
+  nsaved = maxsaved = 0;
+}
+
+/* the read and write procedures of the assembly
+ * code, calling the C library with the stack
+ * aligned as it requires, and those stopping the
+ * program with a message and exit status 1
+ */
+static char * runtime[] = {
+  "rt_readi:",
+  "\tleaq\t.Lfmtd(%rip), %rdi",
+  "\tjmp\t.Lread",
+  "rt_readf:",
+  "\tleaq\t.Lfmtf(%rip), %rdi",
+  ".Lread:",
+  "\tpushq\t%rbp",
+  "\tmovq\t%rsp, %rbp",
+  "\tsubq\t$16, %rsp",
+  "\tandq\t$-16, %rsp",
+  "\tmovl\t$0, -4(%rbp)",
+  "\tleaq\t-4(%rbp), %rsi",
+  "\txorl\t%eax, %eax",
+  "\tcall\tscanf@PLT",
+  "\tmovl\t-4(%rbp), %eax",
+  "\tleave",
+  "\tret",
+  "rt_writei:",
+  "\tpushq\t%rbp",
+  "\tmovq\t%rsp, %rbp",
+  "\tandq\t$-16, %rsp",
+  "\tmovl\t%edi, %esi",
+  "\tleaq\t.Lfmtdn(%rip), %rdi",
+  "\txorl\t%eax, %eax",
+  "\tcall\tprintf@PLT",
+  "\tleave",
+  "\tret",
+  "rt_writef:",
+  "\tpushq\t%rbp",
+  "\tmovq\t%rsp, %rbp",
+  "\tandq\t$-16, %rsp",
+  "\tmovd\t%edi, %xmm0",
+  "\tcvtss2sd\t%xmm0, %xmm0",
+  "\tleaq\t.Lfmtgn(%rip), %rdi",
+  "\tmovl\t$1, %eax",
+  "\tcall\tprintf@PLT",
+  "\tleave",
+  "\tret",
+  "rt_divzero:",
+  "\tleaq\t.Ldivz(%rip), %rbx",
+  "\tjmp\t.Lstop",
+  "rt_divovf:",
+  "\tleaq\t.Ldivo(%rip), %rbx",
+  ".Lstop:",
+  "\tandq\t$-16, %rsp",
+  "\txorl\t%edi, %edi",
+  "\tcall\tfflush@PLT",
+  "\tmovq\tstderr@GOTPCREL(%rip), %rax",
+  "\tmovq\t(%rax), %rsi",
+  "\tmovq\t%rbx, %rdi",
+  "\tcall\tfputs@PLT",
+  "\tmovl\t$1, %edi",
+  "\tcall\texit@PLT",
+  "\t.section\t.rodata",
+  ".Lfmtd:\t.string\t\"%d\"",
+  ".Lfmtf:\t.string\t\"%f\"",
+  ".Lfmtdn:\t.string\t\"%d\\n\"",
+  ".Lfmtgn:\t.string\t\"%g\\n\"",
+  ".Ldivz:\t.string\t\"Division by 0\\n\"",
+  ".Ldivo:\t.string\t\"Division overflow\\n\"",
+  NULL
+};
+
+/**********************************************/
+/* the primary function of the code generator */
+/**********************************************/
+/* Procedure x86Gen generates x86-64 code to the
+ * code file by traversal of the syntax tree: the
+ * program becomes main, and each function fn_name
+ */
+void x86Gen(TreeNode * syntaxTree, char * codefile)
+{ char s[160];
+  int k;
+  xBegin(TRUE);
+  xText("# TINY Compilation to x86-64 Code");
+  sprintf(s,"# File: %.140s",codefile);
+  xText(s);
+  xText("\t.text");
+  genProgram(syntaxTree);
+  xText("");
+  for (k = 0; runtime[k] != NULL; k++) xText(runtime[k]);
+  if (globalWords > 0)
+  { sprintf(s,"\t.local\ttinymem\n\t.comm\ttinymem,%d,16",4*globalWords);
+    xText(s);
+  }
+  xText("\t.section\t.note.GNU-stack,\"\",@progbits");
+  xEnd();
+}
+
+/* the read and write procedures of the machine
+ * code, on stdin and stdout; floats are passed
+ * as their bits
+ */
+static int runReadInt( void )
+{ int v = 0;
+  if (scanf("%d",&v) != 1) v = 0;
+  return v;
+}
+
+static int runReadFloat( void )
+{ union { float f; int i; } v;
+  v.f = 0;
+  if (scanf("%f",&v.f) != 1) v.f = 0;
+  return v.i;
+}
+
+static void runWriteInt( int v )
+{ printf("%d\n",v);
+}
+
+static void runWriteFloat( int bits )
+{ union { float f; int i; } v;
+  v.i = bits;
+  printf("%g\n",v.f);
+}
+
+/* the procedures stopping the program report the
+ * error as TM does and go back to x86Run through
+ * stopRun
+ */
+static jmp_buf stopRun;
+
+static void runStop( char * message )
+{ fflush(stdout);
+  fprintf(stderr,"%s\n",message);
+  longjmp(stopRun,1);
+}
+
+static void runDivZero( void )
+{ runStop("Division by 0");
+}
+
+static void runDivOverflow( void )
+{ runStop("Division overflow");
+}
+
+/* Procedure genStub generates procedure label,
+ * calling C function fn with the stack aligned
+ */
+static void genStub( int label, void (* fn)(void) )
+{ xLabel(label);
+  xR(X_PUSHQ,RBP);
+  xRR(X_MOVQ,RSP,RBP);
+  xIR(X_ANDQ,-16,RSP);
+  xCallC(fn);
+  xOp(X_LEAVE);
+  xOp(X_RET);
+}
+
+int x86Run(TreeNode * syntaxTree)
+{ union { void * p; int (* f)(void); } entry;
+  int result;
+  xBegin(FALSE);
+  genProgram(syntaxTree);
+  genStub(readInt,(void (*)(void)) runReadInt);
+  genStub(readFloat,(void (*)(void)) runReadFloat);
+  genStub(writeInt,(void (*)(void)) runWriteInt);
+  genStub(writeFloat,(void (*)(void)) runWriteFloat);
+  genStub(divZero,runDivZero);
+  genStub(divOverflow,runDivOverflow);
+  entry.p = xMap(mainLabel,globalWords);
+  if (entry.p == NULL)
+  { fprintf(listing,"Cannot map code into executable memory\n");
+    xEnd();
+    return FALSE;
+  }
+  if (setjmp(stopRun) == 0) result = entry.f();
+  else result = 1;
+  fflush(stdout);
+  xEnd();
+  return result == 0;
+}
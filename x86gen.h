@@ -0,0 +1,28 @@
+/****************************************************/
+/* File: x86gen.h                                   */
+/* The x86-64 code generator interface to the TINY  */
+/* compiler                                         */
+/****************************************************/
+
+#ifndef _X86GEN_H_
+#define _X86GEN_H_
+
+/* Procedure x86Gen generates x86-64 assembly code
+ * (GNU as syntax, for the System V ABI) to the
+ * code file by traversal of the syntax tree; read
+ * and write go through the C library, so the code
+ * is linked with cc. The second parameter is the
+ * file name of the code file, printed as a comment
+ */
+void x86Gen(TreeNode * syntaxTree, char * codefile);
+
+/* Function x86Run generates the same code as
+ * machine code in executable memory and runs it,
+ * reading from stdin and writing to stdout;
+ * returns FALSE if it could not be run, or if
+ * the program stopped on a division by 0 or of
+ * INT_MIN by -1, as TM does
+ */
+int x86Run(TreeNode * syntaxTree);
+
+#endif